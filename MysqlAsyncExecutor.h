@@ -0,0 +1,47 @@
+#ifndef MYSQLASYNCEXECUTOR_H
+#define MYSQLASYNCEXECUTOR_H
+
+#include <mysql/mysql.h>
+#include <functional>
+#include <string>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+    }
+}
+
+namespace soul {
+    class MysqlGenerator;
+
+    // outcome of one asynchronous operation
+    struct MysqlAsyncResult {
+        int error;                      // 0, ER_KEY_NOT_FOUND for a select without rows, SQL_* or the mysql error number
+        my_ulonglong affectedRows;      // summed over all statements of the operation
+        std::size_t statement;          // index of the failed statement
+        std::string errorStr;
+
+        MysqlAsyncResult() : error(0), affectedRows(0), statement(0) {}
+    };
+
+    // runs operations away from the calling thread and reports each one through its callback, which is called
+    // once on a thread of the executor. msg and result must stay valid and untouched until then.
+    // implemented by MysqlWorker (blocking MysqlInterface on a thread of its own) and MysqlReactor (non-blocking
+    // connections on an epoll loop), MysqlAwait.h turns the calls into awaitables for C++20 coroutines
+    class MysqlAsyncExecutor {
+        public:
+            typedef std::function<void(const MysqlAsyncResult& result)> Callback;
+
+            virtual ~MysqlAsyncExecutor() {}
+            virtual void ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, const Callback& callback) = 0;
+            virtual void ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) = 0;
+            virtual void ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) = 0;
+            virtual void ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) = 0;
+            virtual void ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) = 0;
+            // an executor running in autocommit mode commits as a no-op and fails a rollback with SQL_NO_TRANSACTION
+            virtual void Commit(const Callback& callback) = 0;
+            virtual void Rollback(const Callback& callback) = 0;
+    };
+}
+
+#endif /*MYSQLASYNCEXECUTOR_H*/
@@ -0,0 +1,131 @@
+#ifndef MYSQLAWAIT_H
+#define MYSQLAWAIT_H
+
+#include <soul/protobuf-mysql/MysqlAsyncExecutor.h>
+
+// the rest of the library builds as C++11, the awaitables need a compiler with coroutines (-std=c++20)
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <functional>
+#include <utility>
+
+namespace soul {
+    // resumes a coroutine whose operation completed, typically by posting handle.resume() to the scheduler
+    // it was suspended on. an empty resumer resumes it right away on the executor thread
+    typedef std::function<void(std::coroutine_handle<> handle)> MysqlResumer;
+
+    template<typename T>
+    struct MysqlSelectResult : MysqlAsyncResult {
+        T message;                      // the selected row(s), the request as it was if nothing was selected
+    };
+
+    // the awaitables live in the coroutine frame. they submit when the coroutine suspends and are not touched
+    // afterwards, the callback may resume the coroutine on another thread before the submit returns
+    class MysqlAwaitableBase {
+        protected:
+            MysqlAsyncExecutor& mExecutor;
+            MysqlResumer mResumer;
+            MysqlAsyncResult mResult;
+
+            MysqlAwaitableBase(MysqlAsyncExecutor& executor, const MysqlResumer& resumer) : mExecutor(executor), mResumer(resumer) {}
+            MysqlAsyncExecutor::Callback Resume(std::coroutine_handle<> handle) {
+                return [this, handle](const MysqlAsyncResult& result) {
+                    mResult = result;
+                    if(mResumer) {
+                        mResumer(handle);
+                    } else {
+                        handle.resume();
+                    }
+                };
+            }
+        public:
+            bool await_ready() const noexcept { return false; }
+    };
+
+    class MysqlAwaitable : public MysqlAwaitableBase {
+        public:
+            typedef std::function<void(MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback)> Submit;
+        private:
+            Submit mSubmit;
+        public:
+            MysqlAwaitable(MysqlAsyncExecutor& executor, const MysqlResumer& resumer, const Submit& submit)
+                : MysqlAwaitableBase(executor, resumer), mSubmit(submit) {}
+
+            void await_suspend(std::coroutine_handle<> handle) { mSubmit(mExecutor, Resume(handle)); }
+            MysqlAsyncResult await_resume() { return std::move(mResult); }
+    };
+
+    template<typename T>
+    class MysqlSelectAwaitable : public MysqlAwaitableBase {
+        private:
+            const MysqlGenerator& mGenerator;
+            T mMessage;
+        public:
+            MysqlSelectAwaitable(MysqlAsyncExecutor& executor, const MysqlResumer& resumer, const MysqlGenerator& generator, const T& request)
+                : MysqlAwaitableBase(executor, resumer), mGenerator(generator), mMessage(request) {}
+
+            void await_suspend(std::coroutine_handle<> handle) { mExecutor.ExecuteSqlSelect(mGenerator, mMessage, Resume(handle)); }
+            MysqlSelectResult<T> await_resume() {
+                MysqlSelectResult<T> result;
+                static_cast<MysqlAsyncResult&>(result) = std::move(mResult);
+                result.message = std::move(mMessage);
+                return result;
+            }
+    };
+
+    // co_await versions of the MysqlInterface calls on an executor:
+    //     MysqlAsync db(worker, post);
+    //     MysqlSelectResult<table_test> row = co_await db.ExecuteSqlSelect(generator, request);
+    //     MysqlAsyncResult inserted = co_await db.ExecuteSqlInsert(generator, row.message);
+    // the coroutine continues through resumer. msg must stay alive until the co_await returns,
+    // which a temporary in the co_await expression does
+    class MysqlAsync {
+        private:
+            MysqlAsyncExecutor& mExecutor;
+            MysqlResumer mResumer;
+        public:
+            explicit MysqlAsync(MysqlAsyncExecutor& executor, const MysqlResumer& resumer = MysqlResumer())
+                : mExecutor(executor), mResumer(resumer) {}
+
+            // request holds the where fields like the result of MysqlInterface::ExecuteSqlSelect and is copied
+            template<typename T>
+            MysqlSelectAwaitable<T> ExecuteSqlSelect(const MysqlGenerator& generator, const T& request) const {
+                return MysqlSelectAwaitable<T>(mExecutor, mResumer, generator, request);
+            }
+            MysqlAwaitable ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) const {
+                return MysqlAwaitable(mExecutor, mResumer, [&generator, &msg](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.ExecuteSqlInsert(generator, msg, callback);
+                });
+            }
+            MysqlAwaitable ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg) const {
+                return MysqlAwaitable(mExecutor, mResumer, [&generator, &msg](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.ExecuteSqlUpdate(generator, msg, callback);
+                });
+            }
+            MysqlAwaitable ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) const {
+                return MysqlAwaitable(mExecutor, mResumer, [&generator, &msg](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.ExecuteSqlUpdateOnInsert(generator, msg, callback);
+                });
+            }
+            MysqlAwaitable ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg) const {
+                return MysqlAwaitable(mExecutor, mResumer, [&generator, &msg](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.ExecuteSqlDelete(generator, msg, callback);
+                });
+            }
+            MysqlAwaitable Commit() const {
+                return MysqlAwaitable(mExecutor, mResumer, [](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.Commit(callback);
+                });
+            }
+            MysqlAwaitable Rollback() const {
+                return MysqlAwaitable(mExecutor, mResumer, [](MysqlAsyncExecutor& executor, const MysqlAsyncExecutor::Callback& callback) {
+                    executor.Rollback(callback);
+                });
+            }
+    };
+}
+
+#endif
+
+#endif /*MYSQLAWAIT_H*/
@@ -0,0 +1,266 @@
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+#include <atomic>
+#include <cerrno>
+#include <clocale>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace soul;
+
+namespace {
+    class CodecRegistry {
+        public:
+            std::mutex mMutex;
+            std::unordered_map<const google::protobuf::Descriptor*, const MysqlCodec*> mGenerated;
+            std::unordered_map<const google::protobuf::Descriptor*, std::unique_ptr<MysqlReflectionCodec>> mReflection;
+            std::atomic<unsigned int> mGeneration;
+
+            CodecRegistry() : mGeneration(0) {}
+
+            static CodecRegistry& Instance() {
+                static CodecRegistry registry;
+                return registry;
+            }
+    };
+
+    // digits only, false on anything else or overflow
+    template<typename T>
+    bool ParseDigits(const char* data, const char* end, T& value) {
+        if(data == end) return false;
+        T result = 0;
+        for(; data != end; ++data) {
+            const unsigned int digit = static_cast<unsigned char>(*data) - '0';
+            if(digit > 9) return false;
+            if(result > (std::numeric_limits<T>::max() - digit) / 10) return false;
+            result = result * 10 + digit;
+        }
+        value = result;
+        return true;
+    }
+
+    template<typename T>
+    bool ParseInteger(const char* data, unsigned long length, T& value) {
+        if(data == nullptr) return false;
+        const char* end = data + length;
+        if(!std::is_signed<T>::value) {
+            return ParseDigits(data, end, value);
+        }
+        typedef typename std::make_unsigned<T>::type Unsigned;
+        const bool negative = data != end && *data == '-';
+        if(negative) ++data;
+        Unsigned magnitude;
+        if(!ParseDigits(data, end, magnitude)) return false;
+        const Unsigned limit = static_cast<Unsigned>(std::numeric_limits<T>::max());
+        if(negative) {
+            if(magnitude > limit + 1) return false;
+            value = magnitude == 0 ? 0 : -static_cast<T>(magnitude - 1) - 1;
+        } else {
+            if(magnitude > limit) return false;
+            value = static_cast<T>(magnitude);
+        }
+        return true;
+    }
+
+    // decimal notation as the server prints DOUBLE, FLOAT and DECIMAL: sign, digits, point, exponent.
+    // strtod alone would also take hex floats, nan and inf
+    bool IsDecimalText(const char* data, const char* end) {
+        for(; data != end; ++data) {
+            const char c = *data;
+            if((c < '0' || c > '9') && c != '.' && c != '-' && c != '+' && c != 'e' && c != 'E') return false;
+        }
+        return true;
+    }
+
+    // strtod reads the decimal point of LC_NUMERIC, cells always use '.'
+    locale_t CLocale() {
+        static const locale_t locale = newlocale(LC_NUMERIC_MASK, "C", static_cast<locale_t>(0));
+        return locale;
+    }
+
+    double ConvertReal(const char* str, char** end, double) {
+        return strtod_l(str, end, CLocale());
+    }
+
+    float ConvertReal(const char* str, char** end, float) {
+        return strtof_l(str, end, CLocale());
+    }
+
+    // strtod needs a terminated string and cells are only bounded by length, so the text is copied first.
+    // no DECIMAL or DOUBLE text comes close to the buffer size
+    template<typename T>
+    bool ParseReal(const char* data, unsigned long length, T& value) {
+        char buffer[128];
+        if(data == nullptr || length == 0 || length >= sizeof(buffer)) return false;
+        if(!IsDecimalText(data, data + length)) return false;
+        std::memcpy(buffer, data, length);
+        buffer[length] = '\0';
+        char* end = nullptr;
+        errno = 0;
+        const T result = ConvertReal(buffer, &end, T());
+        if(end != buffer + length) return false;
+        if(errno == ERANGE && std::isinf(result)) return false;
+        value = result;
+        return true;
+    }
+}
+
+void MysqlCodec::Register(const google::protobuf::Descriptor* descriptor, const MysqlCodec* codec) {
+    CodecRegistry& registry = CodecRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    registry.mGenerated[descriptor] = codec;
+    registry.mGeneration.fetch_add(1);
+}
+
+unsigned int MysqlCodec::Generation() {
+    return CodecRegistry::Instance().mGeneration.load();
+}
+
+const MysqlCodec* MysqlCodec::Find(const google::protobuf::Descriptor* descriptor) {
+    CodecRegistry& registry = CodecRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    auto it = registry.mGenerated.find(descriptor);
+    return it != registry.mGenerated.end() ? it->second : nullptr;
+}
+
+const MysqlCodec& MysqlCodec::GetReflectionCodec(const google::protobuf::Descriptor* descriptor) {
+    CodecRegistry& registry = CodecRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mMutex);
+    std::unique_ptr<MysqlReflectionCodec>& codec = registry.mReflection[descriptor];
+    if(!codec) {
+        codec.reset(new MysqlReflectionCodec(descriptor));
+    }
+    return *codec;
+}
+
+const MysqlCodec& MysqlCodec::Get(const google::protobuf::Descriptor* descriptor) {
+    const MysqlCodec* codec = MysqlCodec::Find(descriptor);
+    return codec != nullptr ? *codec : MysqlCodec::GetReflectionCodec(descriptor);
+}
+
+bool MysqlCodec::ParseInt32(const char* data, unsigned long length, int32_t& value) {
+    return ParseInteger(data, length, value);
+}
+
+bool MysqlCodec::ParseInt64(const char* data, unsigned long length, int64_t& value) {
+    return ParseInteger(data, length, value);
+}
+
+bool MysqlCodec::ParseUInt32(const char* data, unsigned long length, uint32_t& value) {
+    return ParseInteger(data, length, value);
+}
+
+bool MysqlCodec::ParseUInt64(const char* data, unsigned long length, uint64_t& value) {
+    return ParseInteger(data, length, value);
+}
+
+bool MysqlCodec::ParseDouble(const char* data, unsigned long length, double& value) {
+    return ParseReal(data, length, value);
+}
+
+bool MysqlCodec::ParseFloat(const char* data, unsigned long length, float& value) {
+    return ParseReal(data, length, value);
+}
+
+bool MysqlReflectionCodec::HasColumn(const google::protobuf::Message& msg, int column) const {
+    return msg.GetReflection()->HasField(msg, mDescriptor->field(column));
+}
+
+void MysqlReflectionCodec::AppendColumn(MysqlSqlBuilder& builder, const google::protobuf::Message& msg, int column) const {
+    builder.AppendFieldValue(msg.GetReflection(), msg, mDescriptor->field(column));
+}
+
+void MysqlReflectionCodec::AppendRow(MysqlSqlBuilder& builder, const google::protobuf::Message& msg) const {
+    const google::protobuf::Reflection* reflection = msg.GetReflection();
+    builder.Append('(');
+    for(int i = 0; i != mDescriptor->field_count(); ++i) {
+        if(i != 0) {
+            builder.Append(", ");
+        }
+        builder.AppendFieldValue(reflection, msg, mDescriptor->field(i));
+    }
+    builder.Append(')');
+}
+
+bool MysqlReflectionCodec::SetColumn(google::protobuf::Message& msg, int column, const char* data, unsigned long length) const {
+    const google::protobuf::FieldDescriptor* field = mDescriptor->field(column);
+    if(field->is_repeated()) return false;
+    if(data == nullptr) return true;
+    const google::protobuf::Reflection* reflection = msg.GetReflection();
+    switch (field->cpp_type()) {
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+            {
+                int32_t value;
+                if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+                reflection->SetInt32(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+            {
+                int64_t value;
+                if(!MysqlCodec::ParseInt64(data, length, value)) return false;
+                reflection->SetInt64(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+            {
+                uint32_t value;
+                if(!MysqlCodec::ParseUInt32(data, length, value)) return false;
+                reflection->SetUInt32(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+            {
+                uint64_t value;
+                if(!MysqlCodec::ParseUInt64(data, length, value)) return false;
+                reflection->SetUInt64(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+            {
+                double value;
+                if(!MysqlCodec::ParseDouble(data, length, value)) return false;
+                reflection->SetDouble(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+            {
+                float value;
+                if(!MysqlCodec::ParseFloat(data, length, value)) return false;
+                reflection->SetFloat(&msg, field, value);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            {
+                int32_t value;
+                if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+                reflection->SetBool(&msg, field, value != 0);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+            {
+                int32_t value;
+                if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+                const google::protobuf::EnumValueDescriptor* enumValue = field->enum_type()->FindValueByNumber(value);
+                if(enumValue == nullptr) return false;
+                reflection->SetEnum(&msg, field, enumValue);
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+            reflection->SetString(&msg, field, std::string(data, length));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+            return reflection->MutableMessage(&msg, field)->ParseFromArray(data, length);
+        default:
+            return false;
+    }
+    return true;
+}
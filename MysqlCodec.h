@@ -0,0 +1,61 @@
+#ifndef MYSQLCODEC_H
+#define MYSQLCODEC_H
+
+#include <stdint.h>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class Descriptor;
+    }
+}
+
+namespace soul {
+    class MysqlSqlBuilder;
+
+    // column access of one message type, column index is the field index in the descriptor.
+    // protoc-gen-mysql generates implementations using the message accessors directly,
+    // types without a generated codec go through MysqlReflectionCodec
+    class MysqlCodec {
+        public:
+            virtual ~MysqlCodec() {}
+            virtual bool HasColumn(const google::protobuf::Message& msg, int column) const = 0;
+            virtual void AppendColumn(MysqlSqlBuilder& builder, const google::protobuf::Message& msg, int column) const = 0;
+            // "(value1, value2, ...)" of all columns
+            virtual void AppendRow(MysqlSqlBuilder& builder, const google::protobuf::Message& msg) const = 0;
+            // data is a text protocol cell of length bytes, nullptr for NULL which leaves the field unset.
+            // return false if the cell is no valid value of the field, nothing throws
+            virtual bool SetColumn(google::protobuf::Message& msg, int column, const char* data, unsigned long length) const = 0;
+
+            static void Register(const google::protobuf::Descriptor* descriptor, const MysqlCodec* codec);
+            // changes with every Register, a cached result of Get is stale once this differs from when it was taken
+            static unsigned int Generation();
+            // generated codec of the type, nullptr if none is registered
+            static const MysqlCodec* Find(const google::protobuf::Descriptor* descriptor);
+            static const MysqlCodec& GetReflectionCodec(const google::protobuf::Descriptor* descriptor);
+            // generated codec if registered, otherwise the reflection codec
+            static const MysqlCodec& Get(const google::protobuf::Descriptor* descriptor);
+
+            // text protocol cell parsing shared by all codecs, bounded by length so the cell needs no terminator.
+            // return false if data is not a valid number or does not fit value
+            static bool ParseInt32(const char* data, unsigned long length, int32_t& value);
+            static bool ParseInt64(const char* data, unsigned long length, int64_t& value);
+            static bool ParseUInt32(const char* data, unsigned long length, uint32_t& value);
+            static bool ParseUInt64(const char* data, unsigned long length, uint64_t& value);
+            static bool ParseDouble(const char* data, unsigned long length, double& value);
+            static bool ParseFloat(const char* data, unsigned long length, float& value);
+    };
+
+    class MysqlReflectionCodec : public MysqlCodec {
+        private:
+            const google::protobuf::Descriptor* mDescriptor;
+        public:
+            explicit MysqlReflectionCodec(const google::protobuf::Descriptor* descriptor) : mDescriptor(descriptor) {}
+            virtual bool HasColumn(const google::protobuf::Message& msg, int column) const;
+            virtual void AppendColumn(MysqlSqlBuilder& builder, const google::protobuf::Message& msg, int column) const;
+            virtual void AppendRow(MysqlSqlBuilder& builder, const google::protobuf::Message& msg) const;
+            virtual bool SetColumn(google::protobuf::Message& msg, int column, const char* data, unsigned long length) const;
+    };
+}
+
+#endif /*MYSQLCODEC_H*/
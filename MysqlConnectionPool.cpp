@@ -0,0 +1,292 @@
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <soul/protobuf-mysql/MysqlError.h>
+#include <soul/Log.h>
+#include <mysql/errmsg.h>
+#include <google/protobuf/message.h>
+#include <algorithm>
+#include <thread>
+
+using namespace soul;
+
+MysqlConnectionPool::Handle& MysqlConnectionPool::Handle::operator=(Handle&& other) {
+    if(this != &other) {
+        Release();
+        mPool = other.mPool;
+        mConnection = other.mConnection;
+        other.mConnection = nullptr;
+    }
+    return *this;
+}
+
+void MysqlConnectionPool::Handle::Release() {
+    if(mConnection != nullptr) {
+        mPool->Release(mConnection);
+        mConnection = nullptr;
+    }
+}
+
+MysqlConnectionPool::MysqlConnectionPool(const MysqlPoolConfig& config)
+    : mConfig(config), mLastEviction(std::chrono::steady_clock::now())
+{
+    if(mConfig.size == 0) {
+        mConfig.size = 1;
+    }
+    // mysql_init is not thread safe before the library is initialized
+    mysql_library_init(0, nullptr, nullptr);
+    mConnections.resize(mConfig.size);
+    mIdle.reserve(mConfig.size);
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        mConnections[i].reset(new Connection());
+        mIdle.push_back(mConnections[i].get());
+    }
+}
+
+MysqlConnectionPool::~MysqlConnectionPool() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(mIdle.size() != mConnections.size()) {
+        LOG_ERROR << "mysql connection pool destroyed with " << mConnections.size() - mIdle.size() << " connections in use";
+    }
+}
+
+std::unique_ptr<MysqlInterface> MysqlConnectionPool::Open(const MysqlPoolConfig& config) {
+    std::unique_ptr<MysqlInterface> interface(new MysqlInterface());
+    if(interface->Connect(config.host.c_str(), config.port, config.user.c_str(), config.passwd.c_str()) == false) {
+        return nullptr;
+    }
+    if(!config.charset.empty() && interface->SetCharset(config.charset.c_str()) == false) {
+        return nullptr;
+    }
+    if(!config.database.empty() && interface->SwitchDB(config.database.c_str()) != 0) {
+        LOG_ERROR << "select database " << config.database << " failed";
+        return nullptr;
+    }
+    if(config.autoCommit == false) {
+        interface->SetAutoCommit(false);
+    }
+    interface->SetPreparedStatement(config.prepared);
+    if(config.multiStatements) {
+        interface->SetMultiStatements(true);
+    }
+    return interface;
+}
+
+bool MysqlConnectionPool::Prepare(Connection& connection) const {
+    if(connection.interface) {
+        std::chrono::steady_clock::duration idle = std::chrono::steady_clock::now() - connection.lastUsed;
+        if(idle < std::chrono::seconds(mConfig.validateInterval) || connection.interface->Ping()) {
+            return true;
+        }
+        connection.interface.reset();
+    }
+    connection.interface = Open(mConfig);
+    return connection.interface != nullptr;
+}
+
+std::size_t MysqlConnectionPool::Start(std::size_t count) {
+    // the empty slots are checked out while they connect, so Acquire does not connect them as well
+    std::vector<Connection*> slots;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(std::size_t i = 0; i != mIdle.size(); ) {
+            if(slots.size() != count && !mIdle[i]->interface) {
+                slots.push_back(mIdle[i]);
+                mIdle.erase(mIdle.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i != slots.size(); ++i) {
+        threads.emplace_back([this, &slots, i]() {
+            mysql_thread_init();
+            slots[i]->interface = Open(mConfig);
+            mysql_thread_end();
+        });
+    }
+    for(std::size_t i = 0; i != threads.size(); ++i) {
+        threads[i].join();
+    }
+    for(std::size_t i = 0; i != slots.size(); ++i) {
+        Release(slots[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::size_t connected = 0;
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        if(mConnections[i]->interface) {
+            ++connected;
+        }
+    }
+    LOG_DEBUG << "mysql connection pool started, " << connected << " of " << mConnections.size() << " connected";
+    return connected;
+}
+
+MysqlConnectionPool::Handle MysqlConnectionPool::Acquire(int timeout) {
+    Connection* connection = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(timeout < 0) {
+            mAvailable.wait(lock, [this]() { return !mIdle.empty(); });
+        } else if(!mAvailable.wait_for(lock, std::chrono::milliseconds(timeout), [this]() { return !mIdle.empty(); })) {
+            LOG_WARN << "no free mysql connection after " << timeout << " ms";
+            return Handle();
+        }
+        connection = mIdle.back();
+        mIdle.pop_back();
+    }
+    // connecting and pinging run outside the lock, only the thread holding the slot touches it
+    if(Prepare(*connection) == false) {
+        Release(connection);
+        return Handle();
+    }
+    return Handle(this, connection);
+}
+
+void MysqlConnectionPool::Release(Connection* connection) {
+    MysqlInterface* interface = connection->interface.get();
+    if(interface != nullptr && interface->AutoCommit() == false) {
+        // whatever the borrower did not commit must not leak into the next checkout
+        interface->Rollback();
+        if(mConfig.autoCommit) {
+            interface->SetAutoCommit(true);
+        }
+    }
+    connection->lastUsed = std::chrono::steady_clock::now();
+    bool evict = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(connection->interface) {
+            mIdle.push_back(connection);
+        } else {
+            mIdle.insert(mIdle.begin(), connection);
+        }
+        evict = mConfig.idleTimeout > 0 && connection->lastUsed - mLastEviction >= std::chrono::seconds(1);
+    }
+    mAvailable.notify_one();
+    if(evict) {
+        EvictIdle();
+    }
+}
+
+std::size_t MysqlConnectionPool::EvictIdle() {
+    if(mConfig.idleTimeout <= 0) return 0;
+    std::vector<std::unique_ptr<MysqlInterface>> closing;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        mLastEviction = now;
+        std::size_t open = 0;
+        for(std::size_t i = 0; i != mIdle.size(); ++i) {
+            if(mIdle[i]->interface) {
+                ++open;
+            }
+        }
+        // least recently used first, the connections in use now stay warm
+        for(std::size_t i = 0; i != mIdle.size() && open > mConfig.minIdle; ++i) {
+            Connection* connection = mIdle[i];
+            if(!connection->interface) continue;
+            if(now - connection->lastUsed < std::chrono::seconds(mConfig.idleTimeout)) break;
+            closing.push_back(std::move(connection->interface));
+            --open;
+        }
+        std::stable_partition(mIdle.begin(), mIdle.end(), [](const Connection* connection) { return !connection->interface; });
+    }
+    if(!closing.empty()) {
+        LOG_DEBUG << "close " << closing.size() << " idle mysql connections";
+    }
+    return closing.size();
+}
+
+std::size_t MysqlConnectionPool::IdleCount() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mIdle.size();
+}
+
+int MysqlConnectionPool::Commit(MysqlInterface& interface, int ret) {
+    // the handle goes away right after the call, its release would roll the write back
+    if(ret == 0 && interface.AutoCommit() == false && interface.Commit() == false) {
+        return SQL_ROLLBACK;
+    }
+    return ret;
+}
+
+int MysqlConnectionPool::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return handle->ExecuteSqlSelect(generator, result);
+}
+
+int MysqlConnectionPool::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, MysqlSelectMapping& mapping) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return handle->ExecuteSqlSelect(generator, result, mapping);
+}
+
+int MysqlConnectionPool::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, int batchSize, const MysqlInterface::SelectHandler& handler) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return handle->ExecuteSqlSelect(generator, result, batchSize, handler);
+}
+
+int MysqlConnectionPool::ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return Commit(*handle, handle->ExecuteSqlInsert(generator, msg));
+}
+
+int MysqlConnectionPool::ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return Commit(*handle, handle->ExecuteSqlUpdate(generator, msg));
+}
+
+int MysqlConnectionPool::ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return Commit(*handle, handle->ExecuteSqlUpdateOnInsert(generator, msg));
+}
+
+int MysqlConnectionPool::ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    Handle handle = Acquire(mConfig.acquireTimeout);
+    if(!handle) return SQL_NO_CONNECTION;
+    return Commit(*handle, handle->ExecuteSqlDelete(generator, msg));
+}
+
+int MysqlConnectionPool::ExecuteSqlRetry(const MysqlGenerator& generator, MysqlGenerator::StatementType type, const google::protobuf::Message& rows,
+                                         int retryLimit, int retryInterval, const WriteErrorHandler& onError) {
+    int ret = 0;
+    for(int attempt = 0; ; ++attempt) {
+        Handle handle = Acquire(mConfig.acquireTimeout);
+        // prepared statements return the client error, text queries leave it in mysql_errno
+        unsigned int error = SQL_NO_CONNECTION;
+        // chunks an autocommit insert already wrote stay written, running it again would duplicate them
+        bool partial = false;
+        if(handle) {
+            if(type == MysqlGenerator::STATEMENT_INSERT) {
+                ret = handle->ExecuteSqlInsert(generator, rows);
+            } else if(type == MysqlGenerator::STATEMENT_UPDATE) {
+                ret = handle->ExecuteSqlUpdate(generator, rows);
+            } else {
+                ret = handle->ExecuteSqlUpdateOnInsert(generator, rows);
+            }
+            error = ret == CR_SERVER_GONE_ERROR || ret == CR_SERVER_LOST ? ret : handle->LastErrno();
+            partial = ret != 0 && type == MysqlGenerator::STATEMENT_INSERT && handle->AutoCommit() && handle->AffectedRows() != 0;
+            ret = Commit(*handle, ret);
+        } else {
+            ret = SQL_NO_CONNECTION;
+        }
+        if(ret == 0) return 0;
+        bool retry = !partial && (error == SQL_NO_CONNECTION || error == CR_SERVER_GONE_ERROR
+                                  || (error == CR_SERVER_LOST && type != MysqlGenerator::STATEMENT_INSERT));
+        if(!retry || attempt >= retryLimit) break;
+        LOG_WARN << "lost the mysql connection writing " << rows.GetDescriptor()->full_name() << ", retry " << attempt + 1 << " of " << retryLimit;
+        handle.Release();
+        std::this_thread::sleep_for(std::chrono::milliseconds(retryInterval));
+    }
+    LOG_ERROR << "gave up writing " << rows.GetDescriptor()->full_name() << ", error: " << ret;
+    if(onError) {
+        onError(ret, rows);
+    }
+    return ret;
+}
@@ -0,0 +1,125 @@
+#ifndef MYSQLCONNECTIONPOOL_H
+#define MYSQLCONNECTIONPOOL_H
+
+#include <soul/protobuf-mysql/MysqlInterface.h>
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace soul {
+    struct MysqlPoolConfig {
+        std::string host;
+        uint16_t port;
+        std::string user;
+        std::string passwd;
+        std::string charset;            // empty keeps the server default
+        std::string database;           // empty selects none
+        std::size_t size;               // connections at most
+        bool autoCommit;
+        bool prepared;                  // MysqlInterface::SetPreparedStatement on every connection
+        bool multiStatements;           // MysqlInterface::SetMultiStatements on every connection
+        int acquireTimeout;             // ms the pool Execute* calls wait for a free connection, -1 forever
+        int validateInterval;           // s a connection may be idle before a checkout pings it
+        int idleTimeout;                // s an idle connection stays open, 0 never closes
+        std::size_t minIdle;            // open idle connections idle eviction keeps
+
+        MysqlPoolConfig()
+            : port(3306), size(8), autoCommit(true), prepared(false), multiStatements(false),
+              acquireTimeout(3000), validateInterval(30), idleTimeout(600), minIdle(1) {}
+    };
+
+    // a bounded set of MysqlInterface shared by many threads, every connection is used by one thread at a time.
+    // slots are connected lazily on checkout (or up front by Start) so a lost server is retried by at most one
+    // thread per slot instead of by every caller at once
+    class MysqlConnectionPool {
+        private:
+            struct Connection {
+                std::unique_ptr<MysqlInterface> interface;      // nullptr while not connected
+                std::chrono::steady_clock::time_point lastUsed;
+            };
+        public:
+            // a checked out connection, returned to the pool when the handle goes away. keep one handle for a
+            // whole transaction, a transaction still open on return is rolled back
+            class Handle {
+                private:
+                    MysqlConnectionPool* mPool;
+                    Connection* mConnection;
+                public:
+                    Handle() : mPool(nullptr), mConnection(nullptr) {}
+                    Handle(MysqlConnectionPool* pool, Connection* connection) : mPool(pool), mConnection(connection) {}
+                    Handle(Handle&& other) : mPool(other.mPool), mConnection(other.mConnection) {
+                        other.mConnection = nullptr;
+                    }
+                    Handle& operator=(Handle&& other);
+                    Handle(const Handle&) = delete;
+                    Handle& operator=(const Handle&) = delete;
+                    ~Handle() { Release(); }
+
+                    explicit operator bool() const { return mConnection != nullptr; }
+                    MysqlInterface* operator->() const { return mConnection->interface.get(); }
+                    MysqlInterface& operator*() const { return *mConnection->interface; }
+                    void Release();
+            };
+        private:
+            MysqlPoolConfig mConfig;
+            std::mutex mMutex;
+            std::condition_variable mAvailable;
+            std::vector<std::unique_ptr<Connection>> mConnections;
+            std::vector<Connection*> mIdle;                     // least recently used first
+            std::chrono::steady_clock::time_point mLastEviction;
+        public:
+            explicit MysqlConnectionPool(const MysqlPoolConfig& config);
+            // every handle must be released before
+            ~MysqlConnectionPool();
+            MysqlConnectionPool(const MysqlConnectionPool&) = delete;
+            MysqlConnectionPool& operator=(const MysqlConnectionPool&) = delete;
+
+            // connect up to count idle slots in parallel, return the number of open connections
+            std::size_t Start(std::size_t count);
+            // wait up to timeout ms (-1 forever) for a connection, an empty handle if none is free or it
+            // can not be connected
+            Handle Acquire(int timeout);
+            // close connections idle longer than idleTimeout down to minIdle, return the number closed.
+            // checkins run it at most once a second, call it from a timer for a pool that goes quiet
+            std::size_t EvictIdle();
+            std::size_t Size() const { return mConnections.size(); }
+            std::size_t IdleCount();
+            const MysqlPoolConfig& Config() const { return mConfig; }
+            // one connection set up as config describes, nullptr if it fails
+            static std::unique_ptr<MysqlInterface> Open(const MysqlPoolConfig& config);
+
+            // one statement on a connection checked out for the call, SQL_NO_CONNECTION if none is available
+            // within acquireTimeout. use Acquire for transactions and for anything that needs LastError.
+            // without config.autoCommit a successful write is committed before the call returns, SQL_ROLLBACK
+            // if the commit fails
+            int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result);
+            int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, MysqlSelectMapping& mapping);
+            int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, int batchSize, const MysqlInterface::SelectHandler& handler);
+            int ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg);
+            int ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg);
+            int ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg);
+            int ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg);
+
+            // rows a background writer (MysqlWriteBehind, MysqlUpdateCoalescer) could not write
+            typedef std::function<void(int error, const google::protobuf::Message& rows)> WriteErrorHandler;
+            // one insert, update or upsert of rows written and committed like the calls above. while the connection
+            // is lost it is tried again on a new checkout, up to retryLimit times retryInterval ms apart:
+            // SQL_NO_CONNECTION and CR_SERVER_GONE_ERROR did not reach the server, CR_SERVER_LOST may have been
+            // applied and is only tried again for updates and upserts, which write the same values twice.
+            // an insert split into several statements is not tried again once one of them was written with autocommit on.
+            // rows given up are logged and handed to onError, return 0 or the error they were given up with
+            int ExecuteSqlRetry(const MysqlGenerator& generator, MysqlGenerator::StatementType type, const google::protobuf::Message& rows,
+                                int retryLimit, int retryInterval, const WriteErrorHandler& onError);
+        private:
+            bool Prepare(Connection& connection) const;
+            void Release(Connection* connection);
+            static int Commit(MysqlInterface& interface, int ret);
+    };
+}
+
+#endif /*MYSQLCONNECTIONPOOL_H*/
@@ -7,6 +7,9 @@ enum SQL_ERROR {
     SQL_GENERATE_FAIL = 100000,
     SQL_GENERATE_EMPTY = 100001,
     SQL_ROLLBACK = 100002,
+    SQL_DECODE_FAIL = 100003,
+    SQL_NO_CONNECTION = 100004,
+    SQL_NO_TRANSACTION = 100005,
 };
 
 #endif /*MYSQLERROR_H*/
@@ -0,0 +1,508 @@
+#include <soul/protobuf-mysql/MysqlFormat.h>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace soul;
+
+namespace {
+    const char kDigitPairs[] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+    // grisu2 shortest round-trip conversion, see Loitsch "Printing Floating-Point Numbers Quickly and Accurately with Integers"
+    struct DiyFp {
+        uint64_t f;
+        int e;
+        DiyFp(uint64_t f_, int e_) : f(f_), e(e_) {}
+    };
+
+    DiyFp Sub(const DiyFp& x, const DiyFp& y) {
+        return DiyFp(x.f - y.f, x.e);
+    }
+
+    DiyFp Mul(const DiyFp& x, const DiyFp& y) {
+        const uint64_t xLo = x.f & 0xFFFFFFFFu, xHi = x.f >> 32;
+        const uint64_t yLo = y.f & 0xFFFFFFFFu, yHi = y.f >> 32;
+        const uint64_t loLo = xLo * yLo, hiLo = xHi * yLo, loHi = xLo * yHi, hiHi = xHi * yHi;
+        uint64_t middle = (loLo >> 32) + (loHi & 0xFFFFFFFFu) + (hiLo & 0xFFFFFFFFu);
+        middle += uint64_t(1) << 31;
+        return DiyFp(hiHi + (loHi >> 32) + (hiLo >> 32) + (middle >> 32), x.e + y.e + 64);
+    }
+
+    DiyFp Normalize(DiyFp x) {
+        while((x.f >> 63) == 0) {
+            x.f <<= 1;
+            --x.e;
+        }
+        return x;
+    }
+
+    struct CachedPower {
+        uint64_t f;
+        int e;
+        int k;
+    };
+
+    const CachedPower kCachedPowers[] = {
+        { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+        { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+        { 0xBE5691EF416BD60CULL, -1007, -284 },
+        { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+        { 0xD3515C2831559A83ULL,  -954, -268 },
+        { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+        { 0xEA9C227723EE8BCBULL,  -901, -252 },
+        { 0xAECC49914078536DULL,  -874, -244 },
+        { 0x823C12795DB6CE57ULL,  -847, -236 },
+        { 0xC21094364DFB5637ULL,  -821, -228 },
+        { 0x9096EA6F3848984FULL,  -794, -220 },
+        { 0xD77485CB25823AC7ULL,  -768, -212 },
+        { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+        { 0xEF340A98172AACE5ULL,  -715, -196 },
+        { 0xB23867FB2A35B28EULL,  -688, -188 },
+        { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+        { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+        { 0x936B9FCEBB25C996ULL,  -608, -164 },
+        { 0xDBAC6C247D62A584ULL,  -582, -156 },
+        { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+        { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+        { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+        { 0x87625F056C7C4A8BULL,  -475, -124 },
+        { 0xC9BCFF6034C13053ULL,  -449, -116 },
+        { 0x964E858C91BA2655ULL,  -422, -108 },
+        { 0xDFF9772470297EBDULL,  -396, -100 },
+        { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+        { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+        { 0xB94470938FA89BCFULL,  -316,  -76 },
+        { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+        { 0xCDB02555653131B6ULL,  -263,  -60 },
+        { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+        { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+        { 0xAA242499697392D3ULL,  -183,  -36 },
+        { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+        { 0xBCE5086492111AEBULL,  -130,  -20 },
+        { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+        { 0xD1B71758E219652CULL,   -77,   -4 },
+        { 0x9C40000000000000ULL,   -50,    4 },
+        { 0xE8D4A51000000000ULL,   -24,   12 },
+        { 0xAD78EBC5AC620000ULL,     3,   20 },
+        { 0x813F3978F8940984ULL,    30,   28 },
+        { 0xC097CE7BC90715B3ULL,    56,   36 },
+        { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+        { 0xD5D238A4ABE98068ULL,   109,   52 },
+        { 0x9F4F2726179A2245ULL,   136,   60 },
+        { 0xED63A231D4C4FB27ULL,   162,   68 },
+        { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+        { 0x83C7088E1AAB65DBULL,   216,   84 },
+        { 0xC45D1DF942711D9AULL,   242,   92 },
+        { 0x924D692CA61BE758ULL,   269,  100 },
+        { 0xDA01EE641A708DEAULL,   295,  108 },
+        { 0xA26DA3999AEF774AULL,   322,  116 },
+        { 0xF209787BB47D6B85ULL,   348,  124 },
+        { 0xB454E4A179DD1877ULL,   375,  132 },
+        { 0x865B86925B9BC5C2ULL,   402,  140 },
+        { 0xC83553C5C8965D3DULL,   428,  148 },
+        { 0x952AB45CFA97A0B3ULL,   455,  156 },
+        { 0xDE469FBD99A05FE3ULL,   481,  164 },
+        { 0xA59BC234DB398C25ULL,   508,  172 },
+        { 0xF6C69A72A3989F5CULL,   534,  180 },
+        { 0xB7DCBF5354E9BECEULL,   561,  188 },
+        { 0x88FCF317F22241E2ULL,   588,  196 },
+        { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+        { 0x98165AF37B2153DFULL,   641,  212 },
+        { 0xE2A0B5DC971F303AULL,   667,  220 },
+        { 0xA8D9D1535CE3B396ULL,   694,  228 },
+        { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+        { 0xBB764C4CA7A44410ULL,   747,  244 },
+        { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+        { 0xD01FEF10A657842CULL,   800,  260 },
+        { 0x9B10A4E5E9913129ULL,   827,  268 },
+        { 0xE7109BFBA19C0C9DULL,   853,  276 },
+        { 0xAC2820D9623BF429ULL,   880,  284 },
+        { 0x80444B5E7AA7CF85ULL,   907,  292 },
+        { 0xBF21E44003ACDD2DULL,   933,  300 },
+        { 0x8E679C2F5E44FF8FULL,   960,  308 },
+        { 0xD433179D9C8CB841ULL,   986,  316 },
+        { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+    };
+
+    // decompose a float or double (precision bits including the hidden bit) into value and boundaries
+    void ComputeBoundaries(uint64_t bits, int precision, int exponentBits, DiyFp& w, DiyFp& minus, DiyFp& plus) {
+        const int bias = (1 << (exponentBits - 1)) - 1 + (precision - 1);
+        const uint64_t hidden = uint64_t(1) << (precision - 1);
+        const uint64_t exponent = bits >> (precision - 1);
+        const uint64_t fraction = bits & (hidden - 1);
+        DiyFp v = exponent == 0 ? DiyFp(fraction, 1 - bias) : DiyFp(fraction + hidden, static_cast<int>(exponent) - bias);
+        const bool lowerIsCloser = fraction == 0 && exponent > 1;
+        DiyFp mPlus(2 * v.f + 1, v.e - 1);
+        DiyFp mMinus = lowerIsCloser ? DiyFp(4 * v.f - 1, v.e - 2) : DiyFp(2 * v.f - 1, v.e - 1);
+        plus = Normalize(mPlus);
+        minus = DiyFp(mMinus.f << (mMinus.e - plus.e), plus.e);
+        w = Normalize(v);
+    }
+
+    void Grisu2Round(char* buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t tenK) {
+        while(rest < dist && delta - rest >= tenK && (rest + tenK < dist || dist - rest > rest + tenK - dist)) {
+            --buffer[length - 1];
+            rest += tenK;
+        }
+    }
+
+    int Grisu2(char* buffer, int& decimalExponent, const DiyFp& minus, const DiyFp& v, const DiyFp& plus) {
+        const int alpha = -60;
+        const int f = alpha - plus.e - 1;
+        const int k = (f * 78913) / (1 << 18) + (f > 0);
+        const CachedPower& cached = kCachedPowers[(300 + k + 7) / 8];
+        const DiyFp c(cached.f, cached.e);
+        const DiyFp w = Mul(v, c);
+        const DiyFp wMinus = Mul(minus, c);
+        const DiyFp wPlus = Mul(plus, c);
+        const DiyFp mMinus(wMinus.f + 1, wMinus.e);
+        const DiyFp mPlus(wPlus.f - 1, wPlus.e);
+        decimalExponent = -cached.k;
+
+        uint64_t delta = Sub(mPlus, mMinus).f;
+        uint64_t dist = Sub(mPlus, w).f;
+        const DiyFp one(uint64_t(1) << -mPlus.e, mPlus.e);
+        uint32_t p1 = static_cast<uint32_t>(mPlus.f >> -one.e);
+        uint64_t p2 = mPlus.f & (one.f - 1);
+
+        uint32_t pow10 = 1000000000;
+        int n = 10;
+        while(n > 1 && p1 < pow10) {
+            pow10 /= 10;
+            --n;
+        }
+        int length = 0;
+        while(n > 0) {
+            buffer[length++] = static_cast<char>('0' + p1 / pow10);
+            p1 %= pow10;
+            --n;
+            const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+            if(rest <= delta) {
+                decimalExponent += n;
+                Grisu2Round(buffer, length, dist, delta, rest, uint64_t(pow10) << -one.e);
+                return length;
+            }
+            pow10 /= 10;
+        }
+        int m = 0;
+        for(;;) {
+            p2 *= 10;
+            delta *= 10;
+            dist *= 10;
+            buffer[length++] = static_cast<char>('0' + (p2 >> -one.e));
+            p2 &= one.f - 1;
+            ++m;
+            if(p2 <= delta) break;
+        }
+        decimalExponent -= m;
+        Grisu2Round(buffer, length, dist, delta, p2, one.f);
+        return length;
+    }
+
+    // lay out digits * 10^exponent as plain decimal or scientific notation
+    std::size_t FormatDigits(char* out, const char* digits, int length, int exponent) {
+        const int point = length + exponent;
+        char* p = out;
+        if(length <= point && point <= 17) {
+            memcpy(p, digits, length);
+            memset(p + length, '0', point - length);
+            p += point;
+        } else if(0 < point && point <= 17) {
+            memcpy(p, digits, point);
+            p[point] = '.';
+            memcpy(p + point + 1, digits + point, length - point);
+            p += length + 1;
+        } else if(-6 < point && point <= 0) {
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -point);
+            p += -point;
+            memcpy(p, digits, length);
+            p += length;
+        } else {
+            *p++ = digits[0];
+            if(length > 1) {
+                *p++ = '.';
+                memcpy(p, digits + 1, length - 1);
+                p += length - 1;
+            }
+            *p++ = 'e';
+            int e = point - 1;
+            if(e < 0) {
+                *p++ = '-';
+                e = -e;
+            } else {
+                *p++ = '+';
+            }
+            p += MysqlFormat::FormatUInt32(e, p);
+        }
+        return p - out;
+    }
+
+    std::size_t FormatSpecial(double value, char* out) {
+        if(std::isnan(value)) {
+            memcpy(out, "nan", 3);
+            return 3;
+        }
+        if(value == 0) {
+            out[0] = '0';
+            return 1;
+        }
+        memcpy(out, "inf", 3);
+        return 3;
+    }
+
+    // character following the backslash for every byte that needs escaping, 0 otherwise
+    struct EscapeTable {
+        char value[256];
+        EscapeTable() {
+            memset(value, 0, sizeof(value));
+            value[0] = '0';
+            value[static_cast<unsigned char>('\n')] = 'n';
+            value[static_cast<unsigned char>('\r')] = 'r';
+            value[static_cast<unsigned char>('\\')] = '\\';
+            value[static_cast<unsigned char>('\'')] = '\'';
+            value[static_cast<unsigned char>('"')] = '"';
+            value[0x1a] = 'Z';
+        }
+    };
+    const EscapeTable kEscapeTable;
+
+    std::size_t EscapeScalar(const char* str, std::size_t len, char* out) {
+        char* p = out;
+        for(std::size_t i = 0; i != len; ++i) {
+            const char escaped = kEscapeTable.value[static_cast<unsigned char>(str[i])];
+            if(escaped != 0) {
+                *p++ = '\\';
+                *p++ = escaped;
+            } else {
+                *p++ = str[i];
+            }
+        }
+        *p = '\0';
+        return p - out;
+    }
+
+#if defined(__SSE2__)
+    inline int SpecialMask(__m128i v) {
+        __m128i m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x1a)));
+        return _mm_movemask_epi8(m);
+    }
+
+    // copy clean 16 byte blocks in bulk, escape the special bytes of a dirty block one by one
+    std::size_t EscapeSse2(const char* str, std::size_t len, char* out) {
+        char* p = out;
+        std::size_t i = 0;
+        while(i + 16 <= len) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+            int mask = SpecialMask(v);
+            if(mask == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+                p += 16;
+                i += 16;
+                continue;
+            }
+            int copied = 0;
+            while(mask != 0) {
+                const int pos = __builtin_ctz(mask);
+                memcpy(p, str + i + copied, pos - copied);
+                p += pos - copied;
+                *p++ = '\\';
+                *p++ = kEscapeTable.value[static_cast<unsigned char>(str[i + pos])];
+                copied = pos + 1;
+                mask &= mask - 1;
+            }
+            memcpy(p, str + i + copied, 16 - copied);
+            p += 16 - copied;
+            i += 16;
+        }
+        return (p - out) + EscapeScalar(str + i, len - i, p);
+    }
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    __attribute__((target("avx2")))
+    std::size_t EscapeAvx2(const char* str, std::size_t len, char* out) {
+        char* p = out;
+        std::size_t i = 0;
+        while(i + 32 <= len) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(str + i));
+            __m256i m = _mm256_cmpeq_epi8(v, _mm256_setzero_si256());
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x1a)));
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+            if(mask == 0) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+                p += 32;
+                i += 32;
+                continue;
+            }
+            uint32_t copied = 0;
+            while(mask != 0) {
+                const uint32_t pos = __builtin_ctz(mask);
+                memcpy(p, str + i + copied, pos - copied);
+                p += pos - copied;
+                *p++ = '\\';
+                *p++ = kEscapeTable.value[static_cast<unsigned char>(str[i + pos])];
+                copied = pos + 1;
+                mask &= mask - 1;
+            }
+            memcpy(p, str + i + copied, 32 - copied);
+            p += 32 - copied;
+            i += 32;
+        }
+        return (p - out) + EscapeSse2(str + i, len - i, p);
+    }
+#endif
+
+    const char kHexDigits[] = "0123456789ABCDEF";
+
+    std::size_t HexScalar(const char* str, std::size_t len, char* out) {
+        for(std::size_t i = 0; i != len; ++i) {
+            const unsigned char c = static_cast<unsigned char>(str[i]);
+            out[i * 2] = kHexDigits[c >> 4];
+            out[i * 2 + 1] = kHexDigits[c & 0x0F];
+        }
+        return len * 2;
+    }
+
+    typedef std::size_t (*EscapeFunction)(const char*, std::size_t, char*);
+
+    EscapeFunction SelectEscapeFunction() {
+#if defined(__GNUC__) && defined(__x86_64__)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return EscapeAvx2;
+        }
+#endif
+#if defined(__SSE2__)
+        return EscapeSse2;
+#else
+        return EscapeScalar;
+#endif
+    }
+}
+
+std::size_t MysqlFormat::FormatUInt64(uint64_t value, char* out) {
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    while(value >= 100) {
+        const unsigned idx = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        *--p = kDigitPairs[idx + 1];
+        *--p = kDigitPairs[idx];
+    }
+    if(value < 10) {
+        *--p = static_cast<char>('0' + value);
+    } else {
+        const unsigned idx = static_cast<unsigned>(value) * 2;
+        *--p = kDigitPairs[idx + 1];
+        *--p = kDigitPairs[idx];
+    }
+    const std::size_t len = tmp + sizeof(tmp) - p;
+    memcpy(out, p, len);
+    return len;
+}
+
+std::size_t MysqlFormat::FormatUInt32(uint32_t value, char* out) {
+    return MysqlFormat::FormatUInt64(value, out);
+}
+
+std::size_t MysqlFormat::FormatInt64(int64_t value, char* out) {
+    if(value < 0) {
+        *out = '-';
+        return 1 + MysqlFormat::FormatUInt64(0 - static_cast<uint64_t>(value), out + 1);
+    }
+    return MysqlFormat::FormatUInt64(static_cast<uint64_t>(value), out);
+}
+
+std::size_t MysqlFormat::FormatInt32(int32_t value, char* out) {
+    return MysqlFormat::FormatInt64(value, out);
+}
+
+std::size_t MysqlFormat::FormatDouble(double value, char* out) {
+    std::size_t sign = 0;
+    if(std::signbit(value)) {
+        *out = '-';
+        sign = 1;
+        value = -value;
+    }
+    if(value == 0 || !std::isfinite(value)) {
+        return sign + FormatSpecial(value, out + sign);
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    DiyFp w(0, 0), minus(0, 0), plus(0, 0);
+    ComputeBoundaries(bits, 53, 11, w, minus, plus);
+    char digits[20];
+    int exponent = 0;
+    int length = Grisu2(digits, exponent, minus, w, plus);
+    return sign + FormatDigits(out + sign, digits, length, exponent);
+}
+
+std::size_t MysqlFormat::FormatFloat(float value, char* out) {
+    std::size_t sign = 0;
+    if(std::signbit(value)) {
+        *out = '-';
+        sign = 1;
+        value = -value;
+    }
+    if(value == 0 || !std::isfinite(value)) {
+        return sign + FormatSpecial(value, out + sign);
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    DiyFp w(0, 0), minus(0, 0), plus(0, 0);
+    ComputeBoundaries(bits, 24, 8, w, minus, plus);
+    char digits[20];
+    int exponent = 0;
+    int length = Grisu2(digits, exponent, minus, w, plus);
+    return sign + FormatDigits(out + sign, digits, length, exponent);
+}
+
+std::size_t MysqlFormat::EscapeString(const char* str, std::size_t len, char* out) {
+    static const EscapeFunction escape = SelectEscapeFunction();
+    return escape(str, len, out);
+}
+
+std::size_t MysqlFormat::HexEncode(const char* str, std::size_t len, char* out) {
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letter = _mm_set1_epi8('A' - '0' - 10);
+    for(; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letter));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letter));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    return i * 2 + HexScalar(str + i, len - i, out + i * 2);
+}
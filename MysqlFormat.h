@@ -0,0 +1,29 @@
+#ifndef MYSQLFORMAT_H
+#define MYSQLFORMAT_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace soul {
+    // formatting kernels writing into caller memory, none of them allocates
+    class MysqlFormat {
+        public:
+            enum { MAX_NUMBER_LENGTH = 32 };
+
+            // out must hold at least MAX_NUMBER_LENGTH bytes, return written length
+            static std::size_t FormatUInt32(uint32_t value, char* out);
+            static std::size_t FormatUInt64(uint64_t value, char* out);
+            static std::size_t FormatInt32(int32_t value, char* out);
+            static std::size_t FormatInt64(int64_t value, char* out);
+            // shortest text that parses back to the same value
+            static std::size_t FormatDouble(double value, char* out);
+            static std::size_t FormatFloat(float value, char* out);
+
+            // same escaping as mysql_escape_string for ascii compatible charsets, out must hold 2 * len + 1 bytes
+            static std::size_t EscapeString(const char* str, std::size_t len, char* out);
+            // upper case hex digits of every byte, out must hold 2 * len bytes
+            static std::size_t HexEncode(const char* str, std::size_t len, char* out);
+    };
+}
+
+#endif /*MYSQLFORMAT_H*/
@@ -1,463 +1,1227 @@
 #include <soul/protobuf-mysql/MysqlGenerator.h>
-#include <soul/protobuf-mysql/MysqlDescriptor.pb.h>
+#include <soul/protobuf-mysql/MysqlPlan.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+#include <soul/protobuf-mysql/MysqlError.h>
 #include <soul/Log.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/repeated_field.h>
-#include <boost/lexical_cast.hpp>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
 
 using namespace soul;
 
+namespace {
+    // formatted value inside a scratch buffer, length npos if the column is not set
+    struct ValueSpan {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    // rows grouped by the set of columns they set, every value formatted once into values
+    struct RowGroups {
+        std::string values;
+        std::vector<ValueSpan> spans;           // row * column count + column
+        std::vector<std::size_t> rowSizes;      // length of the row in an in list
+        std::vector<uint64_t> masks;            // set columns of each group, bit i is column i
+        std::vector<std::vector<int>> groups;   // row indexes of each group, in order of first appearance
+        int skipped;                            // rows without any column set
+    };
+
+    void GroupRows(const MysqlPlan& plan, const MysqlCodec& codec, const MysqlSqlContext& context, bool hexMessage,
+                   const google::protobuf::Message* const* rows, int count, RowGroups& result) {
+        const std::size_t columnCount = plan.columns.size();
+        MysqlSqlBuilder valueBuilder(result.values, context, hexMessage);
+        valueBuilder.Reserve(count * plan.rowWidth);
+        result.spans.resize(count * columnCount);
+        result.rowSizes.assign(count, 0);
+        result.skipped = 0;
+        std::unordered_map<uint64_t, std::size_t> groupIndex;
+        for(int r = 0; r != count; ++r) {
+            const google::protobuf::Message& row = *rows[r];
+            ValueSpan* rowSpans = &result.spans[r * columnCount];
+            uint64_t mask = 0;
+            std::size_t rowSize = 4;
+            for(std::size_t i = 0; i != columnCount; ++i) {
+                rowSpans[i].offset = result.values.size();
+                rowSpans[i].length = std::string::npos;
+                if(codec.HasColumn(row, i) == false) continue;
+                codec.AppendColumn(valueBuilder, row, i);
+                rowSpans[i].length = result.values.size() - rowSpans[i].offset;
+                rowSize += rowSpans[i].length + 2;
+                mask |= uint64_t(1) << i;
+            }
+            if(mask == 0) {
+                ++result.skipped;
+                continue;
+            }
+            result.rowSizes[r] = rowSize;
+            auto it = groupIndex.find(mask);
+            if(it == groupIndex.end()) {
+                it = groupIndex.insert(std::make_pair(mask, result.groups.size())).first;
+                result.masks.push_back(mask);
+                result.groups.push_back(std::vector<int>());
+            }
+            result.groups[it->second].push_back(r);
+        }
+    }
+
+    // "col in (v1, v2)" or "(col1, col2) in ((a, b), (c, d))" for rows [begin, end) of group g
+    void AppendInList(MysqlSqlBuilder& builder, const MysqlPlan& plan, const RowGroups& groups,
+                      std::size_t g, std::size_t begin, std::size_t end) {
+        const std::size_t columnCount = plan.columns.size();
+        const std::vector<int>& group = groups.groups[g];
+        const uint64_t mask = groups.masks[g];
+        const bool composite = (mask & (mask - 1)) != 0;
+        if(composite) {
+            builder.Append('(');
+        }
+        for(std::size_t i = 0, count = 0; i != columnCount; ++i) {
+            if((mask & (uint64_t(1) << i)) == 0) continue;
+            if(count++ != 0) {
+                builder.Append(", ");
+            }
+            builder.Append(plan.columns[i].name);
+        }
+        builder.Append(composite ? ") in (" : " in (");
+        for(std::size_t loop = begin; loop != end; ++loop) {
+            const ValueSpan* rowSpans = &groups.spans[group[loop] * columnCount];
+            if(loop != begin) {
+                builder.Append(", ");
+            }
+            if(composite) {
+                builder.Append('(');
+            }
+            for(std::size_t i = 0, count = 0; i != columnCount; ++i) {
+                if(rowSpans[i].length == std::string::npos) continue;
+                if(count++ != 0) {
+                    builder.Append(", ");
+                }
+                builder.Append(groups.values.data() + rowSpans[i].offset, rowSpans[i].length);
+            }
+            if(composite) {
+                builder.Append(')');
+            }
+        }
+        builder.Append(')');
+    }
+}
+
 MysqlGenerator::MysqlGenerator(const std::string& database,
                                const std::string& table,
                                const std::string& where)
     : mDataBase(database),
       mTable(table),
-      mWhere(where) 
+      mWhere(where),
+      mPlan(nullptr),
+      mHexMessage(false),
+      mGeneratedCodec(true),
+      mBatchUpdate(false)
 {
     MysqlGenerator::TrimString(mWhere);
+    if(!mWhere.empty()) {
+        mWhereClause = " " + mWhere;
+    }
+    mTarget = MysqlPlanCache::GetTarget(mDataBase, mTable);
+}
+
+void MysqlGenerator::SetMessageEncoding(MessageEncoding encoding) {
+    mHexMessage = encoding == MESSAGE_HEX;
+}
+
+void MysqlGenerator::SetGeneratedCodec(bool on) {
+    mGeneratedCodec = on;
+}
+
+void MysqlGenerator::SetUpdateMode(UpdateMode mode) {
+    mBatchUpdate = mode == UPDATE_BATCH;
+}
+
+void MysqlGenerator::SetMessageType(const google::protobuf::Descriptor* descriptor) {
+    mPlan = MysqlPlanCache::GetPlan(descriptor, mTarget);
+}
+
+const MysqlCodec& MysqlGenerator::GetCodec(const google::protobuf::Descriptor* descriptor) const {
+    if(mPlan != nullptr && mPlan->descriptor == descriptor) {
+        return GetCodec(*mPlan);
+    }
+    return mGeneratedCodec ? MysqlCodec::Get(descriptor) : MysqlCodec::GetReflectionCodec(descriptor);
+}
+
+const MysqlPlan* MysqlGenerator::GetPlan(const google::protobuf::Message& msg) const {
+    if(mPlan != nullptr && mPlan->descriptor == msg.GetDescriptor()) {
+        return mPlan;
+    }
+    return MysqlPlanCache::GetPlan(msg.GetDescriptor(), mTarget);
+}
+
+const MysqlCodec& MysqlGenerator::GetCodec(const MysqlPlan& plan) const {
+    return mGeneratedCodec ? MysqlPlanCache::GetCodec(plan) : *plan.reflection;
 }
 
 std::string MysqlGenerator::GenerateSqlSelect(const google::protobuf::Message& msg) const {
-    return MysqlGenerator::OnlyHoldsOneRepeatedMessageField(msg) ? GenerateSqlSelectMulti(msg) : GenerateSqlSelectSingle(msg);
+    return GenerateSqlSelect(msg, MysqlSqlContext());
 }
 
-int MysqlGenerator::GenerateSqlSelectImpl(const google::protobuf::Message& msg, std::string& sql, bool selectAll) const {
-    sql.clear(); sql = "select "; std::string sqlCondition;
-    const int defaultSqlLength = sql.length();
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
-    const google::protobuf::Reflection* reflection = msg.GetReflection();
+std::string MysqlGenerator::GenerateSqlSelect(const google::protobuf::Message& msg, const MysqlSqlContext& context) const {
+    std::string sql;
+    GenerateSqlSelect(msg, context, sql);
+    return sql;
+}
+
+int MysqlGenerator::GenerateSqlSelect(const google::protobuf::Message& msg, const MysqlSqlContext& context, std::string& sql) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    return plan->element != nullptr ? GenerateSqlSelectMulti(*plan, context, msg, sql) : GenerateSqlSelectSingle(*plan, context, msg, sql);
+}
+
+int MysqlGenerator::GenerateSqlSelectImpl(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
+    sql.clear();
+    if(plan.hasRepeated) {
+        LOG_ERROR << "generate select sql error: has repeated field, sql will be empty";
+        return -1;
+    }
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(plan.rowWidth + plan.target->selectFrom.length() + mWhereClause.length() + 16);
+    builder.Append("select ");
+    const std::size_t defaultSqlLength = builder.Length();
+    const MysqlCodec& codec = GetCodec(plan);
     int emptyFieldCount = 0;
-    for(int i = 0; i != descriptor->field_count(); ++i) {
-        const google::protobuf::FieldDescriptor* field = descriptor->field(i);
-        if(field->is_repeated()) {
-            LOG_ERROR << "generate select sql error: has repeated field, sql will be empty";
-            sql.clear();
-            return -1;
-        }
-        bool hasField = reflection->HasField(msg, field);
-        if(selectAll || hasField == false) {
-            if(sql.length() > defaultSqlLength) {
-                sql += ", ";
-            }
-            sql += field->name();
-        }
-        if(hasField == true) {
-            if(mWhere.empty()) {
-                if(!sqlCondition.empty()) {
-                    sqlCondition += " and ";
-                } else {
-                    sqlCondition += " where ";
-                }
-                sqlCondition += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
-            }
-        } else {
-            ++emptyFieldCount;
+    for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+        const MysqlColumn& column = plan.columns[i];
+        if(codec.HasColumn(msg, i)) continue;
+        if(builder.Length() > defaultSqlLength) {
+            builder.Append(", ");
         }
+        builder.Append(column.name);
+        ++emptyFieldCount;
     }
-    sql += " from " + mDataBase + "." + mTable;
+    builder.Append(plan.target->selectFrom);
     if(mWhere.empty()) {
-        sql += sqlCondition;
+        bool hasCondition = false;
+        for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+            const MysqlColumn& column = plan.columns[i];
+            if(codec.HasColumn(msg, i) == false) continue;
+            builder.Append(hasCondition ? " and " : " where ");
+            builder.Append(column.name).Append(" = ");
+            codec.AppendColumn(builder, msg, i);
+            hasCondition = true;
+        }
     } else {
-        sql += " " + mWhere;
+        builder.Append(mWhereClause);
     }
 
     return emptyFieldCount;
 }
 
-std::string MysqlGenerator::GenerateSqlSelectSingle(const google::protobuf::Message& msg) const {
-    std::string sql;
-    int emptyFieldCount = GenerateSqlSelectImpl(msg, sql, false);
+int MysqlGenerator::GenerateSqlSelectSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
+    int emptyFieldCount = GenerateSqlSelectImpl(plan, context, msg, sql);
 
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
-    if(emptyFieldCount == descriptor->field_count()) {
+    if(emptyFieldCount == plan.columns.size()) {
         sql.clear();
-        GenerateSqlSelectImpl(msg, sql, true);
+        MysqlSqlBuilder(sql, context).Append(plan.selectAll).Append(mWhereClause);
     } else if(emptyFieldCount == 0) {
         sql.clear();
         LOG_ERROR << "generate select sql error: all fields are not empty, sql will be empty";
     }
     MysqlGenerator::LogSql(sql);
-    return sql;
+    return sql.empty() ? SQL_GENERATE_EMPTY : 0;
 }
 
-std::string MysqlGenerator::GenerateSqlSelectMulti(const google::protobuf::Message& msg) const {
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
+int MysqlGenerator::GenerateSqlSelectMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
     const google::protobuf::Reflection* reflection = msg.GetReflection();
-    if(descriptor->field_count() == 0) {
-        LOG_ERROR << "generate multi select sql error: msg is empty, sql will be empty";
-        return "";
-    }
-    const google::protobuf::FieldDescriptor* field = descriptor->field(0);
-    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, field);
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan.columns[0].field);
     if(repeatedMsg.empty()) {
         LOG_ERROR << "generate multi select sql error: repeated field is empty, expect has one element, sql will be empty";
-        return "";
+        sql.clear();
+        return SQL_GENERATE_EMPTY;
     }
-    return GenerateSqlSelectSingle(repeatedMsg[0]);
+    if(repeatedMsg.size() == 1 || !mWhere.empty() || plan.element->hasRepeated || plan.element->columns.size() > 64) {
+        return GenerateSqlSelectSingle(*plan.element, context, repeatedMsg[0], sql);
+    }
+    return GenerateSqlSelectKeys(*plan.element, context, repeatedMsg, sql);
 }
 
-std::string MysqlGenerator::GenerateSqlInsert(const google::protobuf::Message& msg) const {
-    return MysqlGenerator::OnlyHoldsOneRepeatedMessageField(msg) ? GenerateSqlInsertMulti(msg) : GenerateSqlInsertSingle(msg);
+// every element is a lookup key: select all columns where col in (...) or (col1, col2) in (...) ...
+int MysqlGenerator::GenerateSqlSelectKeys(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                          const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, std::string& sql) const {
+    sql.clear();
+    RowGroups groups;
+    GroupRows(plan, GetCodec(plan), context, mHexMessage, rows.data(), rows.size(), groups);
+    if(groups.skipped != 0) {
+        LOG_ERROR << "generate multi select sql error: all fields are empty, " << groups.skipped << " keys will be skipped";
+    }
+    if(groups.groups.empty()) {
+        LOG_ERROR << "generate multi select sql error: no key is setted, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(plan.selectAll.length() + groups.values.length() + rows.size() * 4 + groups.groups.size() * (plan.allColumns.length() + 16));
+    builder.Append(plan.selectAll).Append(" where ");
+    for(std::size_t g = 0; g != groups.groups.size(); ++g) {
+        if(g != 0) {
+            builder.Append(" or ");
+        }
+        AppendInList(builder, plan, groups, g, 0, groups.groups[g].size());
+    }
+    MysqlGenerator::LogSql(sql);
+    return 0;
 }
 
-std::string MysqlGenerator::GenerateSqlInsertSingle(const google::protobuf::Message& msg, bool update) const {
-    std::string sql = "insert into " + mDataBase + "." + mTable + " (";
-    int defaultSqlLength = sql.length();
-    std::string sqlCondition = "(";
-    std::string updateSql = update ? " on duplicate key update " : "";
-    int defaultUpdateSqlLength = updateSql.length();
-    int emptyFieldCount = 0;
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
-    const google::protobuf::Reflection* reflection = msg.GetReflection();
-    for(int i = 0; i != descriptor->field_count(); ++i) {
-        const google::protobuf::FieldDescriptor* field = descriptor->field(i);
-        if(field->is_repeated()) {
-            LOG_ERROR << "generate single insert sql error: field can not be repeated, sql will be empty";
-            return "";
-        }
-        if(reflection->HasField(msg, field) == false) {
-            ++emptyFieldCount;
-            continue;
-        }
-        if(sql.length() > defaultSqlLength) {
-            sql += ", ";
-            sqlCondition += ", ";
+void MysqlGenerator::MapSelectResult(const google::protobuf::Message& request, const google::protobuf::Message& result, MysqlSelectMapping& mapping) const {
+    mapping.rowRequest.clear();
+    mapping.missing.clear();
+    const MysqlPlan* plan = GetPlan(request);
+    if(plan->element == nullptr || plan->element->columns.size() > 64) return;
+    const google::protobuf::Reflection* reflection = request.GetReflection();
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& requests = reflection->GetRepeatedPtrField<google::protobuf::Message>(request, plan->columns[0].field);
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows = result.GetReflection()->GetRepeatedPtrField<google::protobuf::Message>(result, plan->columns[0].field);
+    std::vector<bool> found(requests.size(), false);
+    mapping.rowRequest.assign(rows.size(), -1);
+    if(requests.size() == 1) {
+        // a single element selects only the columns it does not set, every row belongs to it
+        mapping.rowRequest.assign(rows.size(), 0);
+        found[0] = !rows.empty();
+    } else {
+        const MysqlPlan& element = *plan->element;
+        const MysqlCodec& codec = GetCodec(element);
+        MysqlSqlContext context;
+        RowGroups groups;
+        GroupRows(element, codec, context, mHexMessage, requests.data(), requests.size(), groups);
+        // key of a row in a group: mask followed by the formatted values of the group columns.
+        // keys map to the first element requesting them, next chains the later ones
+        std::unordered_map<std::string, int> keys;
+        std::vector<int> next(requests.size(), -1);
+        std::vector<int> last(requests.size(), -1);
+        std::string key;
+        for(std::size_t g = 0; g != groups.groups.size(); ++g) {
+            for(std::size_t loop = 0; loop != groups.groups[g].size(); ++loop) {
+                const int r = groups.groups[g][loop];
+                key.assign(reinterpret_cast<const char*>(&groups.masks[g]), sizeof(uint64_t));
+                const ValueSpan* rowSpans = &groups.spans[r * element.columns.size()];
+                for(std::size_t i = 0; i != element.columns.size(); ++i) {
+                    if(rowSpans[i].length == std::string::npos) continue;
+                    key.append(groups.values, rowSpans[i].offset, rowSpans[i].length).push_back('\0');
+                }
+                auto inserted = keys.insert(std::make_pair(key, r));
+                if(!inserted.second) {
+                    const int first = inserted.first->second;
+                    next[last[first] == -1 ? first : last[first]] = r;
+                    last[first] = r;
+                }
+            }
         }
-        sql += field->name();
-        sqlCondition += MysqlGenerator::GetFieldValue(reflection, msg, field);
-        if(update && field->options().GetExtension(primarykey) == false) {
-            if(updateSql.length() > defaultUpdateSqlLength) {
-                updateSql += ", ";
+        std::string values;
+        MysqlSqlBuilder builder(values, context, mHexMessage);
+        for(int row = 0; row != rows.size(); ++row) {
+            // a row can satisfy elements of several groups, check them all
+            for(std::size_t g = 0; g != groups.masks.size(); ++g) {
+                const uint64_t mask = groups.masks[g];
+                key.assign(reinterpret_cast<const char*>(&mask), sizeof(uint64_t));
+                for(std::size_t i = 0; i != element.columns.size(); ++i) {
+                    if((mask & (uint64_t(1) << i)) == 0) continue;
+                    builder.Truncate(0);
+                    codec.AppendColumn(builder, rows[row], i);
+                    key.append(values).push_back('\0');
+                }
+                auto it = keys.find(key);
+                if(it == keys.end()) continue;
+                if(mapping.rowRequest[row] == -1 || it->second < mapping.rowRequest[row]) {
+                    mapping.rowRequest[row] = it->second;
+                }
+                for(int r = it->second; r != -1; r = next[r]) {
+                    found[r] = true;
+                }
             }
-            updateSql += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
         }
     }
-    if(emptyFieldCount == descriptor->field_count()) {
+    for(int r = 0; r != requests.size(); ++r) {
+        if(!found[r]) {
+            mapping.missing.push_back(r);
+        }
+    }
+}
+
+std::string MysqlGenerator::GenerateSqlInsert(const google::protobuf::Message& msg) const {
+    return GenerateSqlInsert(msg, MysqlSqlContext());
+}
+
+std::string MysqlGenerator::GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    std::string sql;
+    if(plan->element != nullptr) {
+        GenerateSqlInsertMulti(*plan, context, msg, sql);
+    } else {
+        GenerateSqlInsertSingle(*plan, context, msg, sql);
+    }
+    return sql;
+}
+
+int MysqlGenerator::GenerateSqlInsertSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                            std::string& sql, bool update) const {
+    sql.clear();
+    if(plan.hasRepeated) {
+        LOG_ERROR << "generate single insert sql error: field can not be repeated, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(plan.target->insertInto.length() + plan.rowWidth * (update ? 3 : 1) + 40);
+    builder.Append(plan.target->insertInto);
+    const std::size_t defaultSqlLength = builder.Length();
+    const MysqlCodec& codec = GetCodec(plan);
+    for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+        const MysqlColumn& column = plan.columns[i];
+        if(codec.HasColumn(msg, i) == false) continue;
+        if(builder.Length() > defaultSqlLength) {
+            builder.Append(", ");
+        }
+        builder.Append(column.name);
+    }
+    if(builder.Length() == defaultSqlLength) {
         LOG_ERROR << "generate single insert sql error: no field is setted, sql will be empty";
-        return "";
+        sql.clear();
+        return SQL_GENERATE_EMPTY;
+    }
+    builder.Append(") values (");
+    bool first = true;
+    for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+        if(codec.HasColumn(msg, i) == false) continue;
+        if(!first) {
+            builder.Append(", ");
+        }
+        codec.AppendColumn(builder, msg, i);
+        first = false;
+    }
+    builder.Append(')');
+    if(update) {
+        builder.Append(" on duplicate key update ");
+        const std::size_t defaultUpdateSqlLength = builder.Length();
+        for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+            const MysqlColumn& column = plan.columns[i];
+            if(column.primaryKey || codec.HasColumn(msg, i) == false) continue;
+            if(builder.Length() > defaultUpdateSqlLength) {
+                builder.Append(", ");
+            }
+            builder.Append(column.name).Append(" = values(").Append(column.name).Append(')');
+        }
+        if(builder.Length() == defaultUpdateSqlLength) {
+            builder.Truncate(defaultUpdateSqlLength - (sizeof(" on duplicate key update ") - 1));
+        }
     }
-    sqlCondition += ")";
-    sql += ") values " + sqlCondition + updateSql;
 
     MysqlGenerator::LogSql(sql);
-    return sql;
+    return 0;
 }
 
-std::string MysqlGenerator::GenerateSqlInsertMulti(const google::protobuf::Message& msg) const {
-    std::string sql = "insert into " + mDataBase + "." + mTable + " (";
-    std::string sqlCondition;
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
+int MysqlGenerator::GenerateSqlInsertMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
+    sql.clear();
     const google::protobuf::Reflection* reflection = msg.GetReflection();
-    if(descriptor->field_count() == 0) {
-        LOG_ERROR << "generate multi insert sql error: msg is empty, sql will be empty";
-        return "";
-    }
-    const google::protobuf::FieldDescriptor* field = descriptor->field(0);
-    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, field);
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan.columns[0].field);
     if(repeatedMsg.empty()) {
         LOG_ERROR << "generate multi insert sql error: repeated field is empty, sql will be empty";
-        return "";
+        return SQL_GENERATE_EMPTY;
     }
+    const MysqlPlan& element = *plan.element;
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(element.insertAll.length() + repeatedMsg.size() * (element.rowWidth + 4));
+    builder.Append(element.insertAll);
+    const MysqlCodec& codec = GetCodec(element);
     for(int i = 0; i != repeatedMsg.size(); ++i) {
-        const google::protobuf::Message& subMsg = repeatedMsg[i];
-        const google::protobuf::Descriptor* subDescriptor = subMsg.GetDescriptor();
-        const google::protobuf::Reflection* subReflection = subMsg.GetReflection();
-        sqlCondition += "(";
-        for(int loop = 0; loop != subDescriptor->field_count(); ++loop) {
-            const google::protobuf::FieldDescriptor* subMsgField = subDescriptor->field(loop);
-            if(i == 0) {
-                if(loop != 0) {
-                    sql += ", ";
-                }
-                sql += subMsgField->name();
-            }
-            if(loop != 0) {
-                sqlCondition += ", ";
-            }
-            sqlCondition += MysqlGenerator::GetFieldValue(subReflection, subMsg, subMsgField);
-        }
-        sqlCondition += ")";
-        if(i != repeatedMsg.size() - 1) {
-            sqlCondition += ", ";
+        if(i != 0) {
+            builder.Append(", ");
         }
+        codec.AppendRow(builder, repeatedMsg[i]);
     }
-    sql += ") values " + sqlCondition;
 
     MysqlGenerator::LogSql(sql);
-    return sql;
+    return 0;
 }
 
-std::vector<std::string> MysqlGenerator::GenerateSqlUpdate(const google::protobuf::Message& msg) const {
-    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(msg)) {
-        return GenerateSqlUpdateMulti(msg);
-    } else {
-        std::vector<std::string> vec;
-        std::string sql = GenerateSqlUpdateSingle(msg);
-        if(!sql.empty()) {
-            vec.push_back(sql);
+int MysqlGenerator::GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const {
+    std::string sql;
+    return GenerateSqlInsert(msg, context, sink, sql);
+}
+
+int MysqlGenerator::GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element == nullptr) {
+        int ret = GenerateSqlInsertSingle(*plan, context, msg, buffer);
+        return ret != 0 ? ret : sink(buffer);
+    }
+    const google::protobuf::Reflection* reflection = msg.GetReflection();
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan->columns[0].field);
+    if(repeatedMsg.empty()) {
+        LOG_ERROR << "generate multi insert sql error: repeated field is empty, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    return GenerateSqlInsertRows(*plan->element, context, repeatedMsg.data(), repeatedMsg.size(), sink, buffer);
+}
+
+int MysqlGenerator::GenerateSqlInsertRows(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                          const google::protobuf::Message* const* rows, int count, const SqlSink& sink, std::string& sql) const {
+    if(plan.hasRepeated) {
+        LOG_ERROR << "generate multi insert sql error: field can not be repeated, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    const std::size_t limit = context.PacketLimit();
+    const MysqlCodec& codec = GetCodec(plan);
+    sql.clear();
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(std::min(limit, plan.insertAll.length() + count * (plan.rowWidth + 4)));
+    builder.Append(plan.insertAll);
+    const std::size_t defaultSqlLength = builder.Length();
+    for(int i = 0; i != count; ++i) {
+        const std::size_t rowStart = builder.Length();
+        if(rowStart != defaultSqlLength) {
+            builder.Append(", ");
+        }
+        codec.AppendRow(builder, *rows[i]);
+        if(builder.Length() > limit && rowStart != defaultSqlLength) {
+            // the row does not fit any more, flush what is before it and start the next statement with it.
+            // the row is formatted again rather than kept aside, sink may generate sql on this thread itself
+            builder.Truncate(rowStart);
+            MysqlGenerator::LogSql(sql);
+            int ret = sink(sql);
+            if(ret != 0) return ret;
+            builder.Truncate(defaultSqlLength);
+            codec.AppendRow(builder, *rows[i]);
         }
-        return vec;
     }
+    MysqlGenerator::LogSql(sql);
+    return sink(sql);
 }
 
-std::string MysqlGenerator::GenerateSqlUpdateSingle(const google::protobuf::Message& msg) const {
-    std::string sql = "update " + mDataBase + "." + mTable + " set ";
-    int defaultSqlLength = sql.length();
-    std::string sqlCondition;
-    bool hasUpdateKey = false;
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
-    const google::protobuf::Reflection* reflection = msg.GetReflection();
-    for(int i = 0; i != descriptor->field_count(); ++i) {
-        const google::protobuf::FieldDescriptor* field = descriptor->field(i);
-        if(field->is_repeated()) {
-            LOG_ERROR << "generate update sql error: field can not be repeated, sql will be empty";
-            return "";
-        }
-        if(reflection->HasField(msg, field) == false) {
-            if(field->options().GetExtension(updatekey) && mWhere.empty()) {
+std::vector<std::string> MysqlGenerator::GenerateSqlUpdate(const google::protobuf::Message& msg) const {
+    return GenerateSqlUpdate(msg, MysqlSqlContext());
+}
+
+std::vector<std::string> MysqlGenerator::GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context) const {
+    std::vector<std::string> sqls;
+    GenerateSqlUpdate(msg, context, [&sqls](const std::string& sql) {
+        sqls.push_back(sql);
+        return 0;
+    });
+    return sqls;
+}
+
+int MysqlGenerator::GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const {
+    std::string sql;
+    return GenerateSqlUpdate(msg, context, sink, sql);
+}
+
+int MysqlGenerator::GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element != nullptr) {
+        return GenerateSqlUpdateMulti(*plan, context, msg, sink, buffer);
+    }
+    int ret = GenerateSqlUpdateSingle(*plan, context, msg, buffer);
+    return ret != 0 ? ret : sink(buffer);
+}
+
+int MysqlGenerator::GenerateSqlUpdateSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
+    sql.clear();
+    if(plan.hasRepeated) {
+        LOG_ERROR << "generate update sql error: field can not be repeated, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    if(plan.hasUpdateKey == false && mWhere.empty()) {
+        LOG_ERROR << "generate upate sql error: not found option 'updatekey' and where condtion is emtpy, sql will be emtpy";
+        return SQL_GENERATE_EMPTY;
+    }
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(plan.target->updateSet.length() + plan.rowWidth + mWhereClause.length() + 8);
+    builder.Append(plan.target->updateSet);
+    const std::size_t defaultSqlLength = builder.Length();
+    const MysqlCodec& codec = GetCodec(plan);
+    for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+        const MysqlColumn& column = plan.columns[i];
+        if(codec.HasColumn(msg, i) == false) {
+            if(column.updateKey && mWhere.empty()) {
                 LOG_ERROR << "generate update sql error: filed with option 'updatekey' can not be empty, sql will be empty";
-                return "";
+                sql.clear();
+                return SQL_GENERATE_EMPTY;
             }
             continue;
         }
-        if(field->options().GetExtension(updatekey)) {
-            hasUpdateKey = true;
-            if(mWhere.empty()) {
-                if(!sqlCondition.empty()) {
-                    sqlCondition += ", ";
-                }
-                sqlCondition += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
-            } else if(reflection->HasField(msg, field)) {
-                if(sql.length() > defaultSqlLength) {
-                    sql += ", ";
-                }
-                sql += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
-            }
-        } else {
-            if(sql.length() > defaultSqlLength) {
-                sql += ", ";
-            }
-            sql += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
+        if(column.updateKey && mWhere.empty()) continue;
+        if(builder.Length() > defaultSqlLength) {
+            builder.Append(", ");
         }
-    }
-
-    if(hasUpdateKey == false && mWhere.empty()) {
-        LOG_ERROR << "generate upate sql error: not found option 'updatekey' and where condtion is emtpy, sql will be emtpy";
-        return "";
+        builder.Append(column.name).Append(" = ");
+        codec.AppendColumn(builder, msg, i);
     }
 
     if(mWhere.empty()) {
-        if(!sqlCondition.empty()) {
-            sql += " where " + sqlCondition;
+        bool hasCondition = false;
+        for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+            const MysqlColumn& column = plan.columns[i];
+            if(column.updateKey == false) continue;
+            builder.Append(hasCondition ? ", " : " where ");
+            builder.Append(column.name).Append(" = ");
+            codec.AppendColumn(builder, msg, i);
+            hasCondition = true;
         }
     } else {
-        sql += " " + mWhere;
+        builder.Append(mWhereClause);
     }
 
     MysqlGenerator::LogSql(sql);
-    return sql;
+    return 0;
 }
 
-std::vector<std::string> MysqlGenerator::GenerateSqlUpdateMulti(const google::protobuf::Message& msg) const {
-    std::vector<std::string> sqls;
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
+int MysqlGenerator::GenerateSqlUpdateMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                           const SqlSink& sink, std::string& sql) const {
     const google::protobuf::Reflection* reflection = msg.GetReflection();
-    if(descriptor->field_count() == 0) {
-        LOG_ERROR << "generate multi update sql error: msg is empty, sql will be empty";
-        return sqls;
-    }
-    const google::protobuf::FieldDescriptor* field = descriptor->field(0);
-    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, field);
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan.columns[0].field);
     if(repeatedMsg.empty()) {
         LOG_ERROR << "generate multi update sql error: repeated filed is empty, sql will be empty";
-        return sqls;
+        return SQL_GENERATE_EMPTY;
+    }
+    if(mBatchUpdate && mWhere.empty() && plan.element->hasUpdateKey && !plan.element->hasRepeated) {
+        return GenerateSqlUpdateBatch(*plan.element, context, repeatedMsg, sink, sql);
     }
+    int generated = 0;
     for(int i = 0; i != repeatedMsg.size(); ++i) {
-        std::string sql = GenerateSqlUpdateSingle(repeatedMsg[i]);
-        if(!sql.empty()) {
-            sqls.push_back(sql);
+        if(GenerateSqlUpdateSingle(*plan.element, context, repeatedMsg[i], sql) != 0) continue;
+        int ret = sink(sql);
+        if(ret != 0) return ret;
+        ++generated;
+    }
+    return generated == 0 ? SQL_GENERATE_EMPTY : 0;
+}
+
+// update db.t set col = case key when k1 then v1 when k2 then v2 else col end, ... where key in (k1, k2)
+// composite keys use "when key1 = a and key2 = b" and "(key1, key2) in ((a, b), ...)".
+// case takes the first matching when, rows are written in reverse order so the last row wins like per row updates
+int MysqlGenerator::GenerateSqlUpdateBatch(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                           const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, const SqlSink& sink, std::string& sql) const {
+    const MysqlCodec& codec = GetCodec(plan);
+    const std::size_t columnCount = plan.columns.size();
+    std::vector<std::size_t> keys;
+    for(std::size_t i = 0; i != columnCount; ++i) {
+        if(plan.columns[i].updateKey) {
+            keys.push_back(i);
         }
     }
-    return sqls;
+    const bool composite = keys.size() > 1;
+
+    std::string values;
+    MysqlSqlBuilder valueBuilder(values, context, mHexMessage);
+    valueBuilder.Reserve(rows.size() * plan.rowWidth);
+    std::vector<ValueSpan> spans(rows.size() * columnCount);
+    std::vector<int> valid;
+    std::vector<std::size_t> rowSizes;
+    valid.reserve(rows.size());
+    rowSizes.reserve(rows.size());
+    for(int r = 0; r != rows.size(); ++r) {
+        const google::protobuf::Message& row = rows[r];
+        ValueSpan* rowSpans = &spans[r * columnCount];
+        bool hasKey = true;
+        std::size_t setCount = 0, setSize = 0;
+        for(std::size_t i = 0; i != columnCount; ++i) {
+            rowSpans[i].offset = values.size();
+            rowSpans[i].length = std::string::npos;
+            if(codec.HasColumn(row, i) == false) {
+                if(plan.columns[i].updateKey) {
+                    hasKey = false;
+                    break;
+                }
+                continue;
+            }
+            codec.AppendColumn(valueBuilder, row, i);
+            rowSpans[i].length = values.size() - rowSpans[i].offset;
+            if(plan.columns[i].updateKey == false) {
+                ++setCount;
+                setSize += rowSpans[i].length;
+            }
+        }
+        if(hasKey == false) {
+            LOG_ERROR << "generate update sql error: filed with option 'updatekey' can not be empty, row will be skipped";
+            continue;
+        }
+        if(setCount == 0) continue;
+        std::size_t keySize = 0;
+        for(std::size_t k = 0; k != keys.size(); ++k) {
+            keySize += rowSpans[keys[k]].length + (composite ? plan.columns[keys[k]].name.length() + 8 : 0);
+        }
+        valid.push_back(r);
+        rowSizes.push_back(setSize + setCount * (keySize + 12) + keySize + 4);
+    }
+    if(valid.empty()) {
+        LOG_ERROR << "generate batch update sql error: no row can be updated, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+
+    std::size_t fixedSize = plan.target->updateSet.length() + 16;
+    for(std::size_t i = 0; i != columnCount; ++i) {
+        fixedSize += plan.columns[i].name.length() * 2 + 24 + (composite ? 0 : plan.columns[keys[0]].name.length());
+    }
+    const std::size_t limit = context.PacketLimit();
+
+    std::size_t begin = 0;
+    while(begin != valid.size()) {
+        std::size_t end = begin, chunkSize = fixedSize;
+        while(end != valid.size() && (end == begin || chunkSize + rowSizes[end] <= limit)) {
+            chunkSize += rowSizes[end];
+            ++end;
+        }
+
+        sql.clear();
+        MysqlSqlBuilder builder(sql, context, mHexMessage);
+        builder.Reserve(chunkSize);
+        builder.Append(plan.target->updateSet);
+        const std::size_t defaultSqlLength = builder.Length();
+        for(std::size_t i = 0; i != columnCount; ++i) {
+            const MysqlColumn& column = plan.columns[i];
+            if(column.updateKey) continue;
+            bool first = true;
+            for(std::size_t loop = end; loop != begin; --loop) {
+                const ValueSpan* rowSpans = &spans[valid[loop - 1] * columnCount];
+                if(rowSpans[i].length == std::string::npos) continue;
+                if(first) {
+                    if(builder.Length() > defaultSqlLength) {
+                        builder.Append(", ");
+                    }
+                    builder.Append(column.name).Append(" = case");
+                    if(!composite) {
+                        builder.Append(' ').Append(plan.columns[keys[0]].name);
+                    }
+                    first = false;
+                }
+                builder.Append(" when ");
+                for(std::size_t k = 0; k != keys.size(); ++k) {
+                    const ValueSpan& key = rowSpans[keys[k]];
+                    if(composite) {
+                        if(k != 0) {
+                            builder.Append(" and ");
+                        }
+                        builder.Append(plan.columns[keys[k]].name).Append(" = ");
+                    }
+                    builder.Append(values.data() + key.offset, key.length);
+                }
+                builder.Append(" then ").Append(values.data() + rowSpans[i].offset, rowSpans[i].length);
+            }
+            if(!first) {
+                builder.Append(" else ").Append(column.name).Append(" end");
+            }
+        }
+
+        builder.Append(" where ");
+        if(composite) {
+            builder.Append('(');
+            for(std::size_t k = 0; k != keys.size(); ++k) {
+                if(k != 0) {
+                    builder.Append(", ");
+                }
+                builder.Append(plan.columns[keys[k]].name);
+            }
+            builder.Append(')');
+        } else {
+            builder.Append(plan.columns[keys[0]].name);
+        }
+        builder.Append(" in (");
+        for(std::size_t loop = begin; loop != end; ++loop) {
+            const ValueSpan* rowSpans = &spans[valid[loop] * columnCount];
+            if(loop != begin) {
+                builder.Append(", ");
+            }
+            if(composite) {
+                builder.Append('(');
+            }
+            for(std::size_t k = 0; k != keys.size(); ++k) {
+                const ValueSpan& key = rowSpans[keys[k]];
+                if(k != 0) {
+                    builder.Append(", ");
+                }
+                builder.Append(values.data() + key.offset, key.length);
+            }
+            if(composite) {
+                builder.Append(')');
+            }
+        }
+        builder.Append(')');
+
+        MysqlGenerator::LogSql(sql);
+        int ret = sink(sql);
+        if(ret != 0) return ret;
+        begin = end;
+    }
+    return 0;
 }
 
 std::string MysqlGenerator::GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg) const {
-    return GenerateSqlInsertSingle(msg, true);
+    return GenerateSqlUpdateOnInsert(msg, MysqlSqlContext());
 }
 
-std::string MysqlGenerator::GenerateSqlDeleteSingle(const google::protobuf::Message& msg) const {
-    std::string sql = "delete from " + mDataBase + "." + mTable;
-    if(mWhere.empty()) {
-        std::string sqlCondition;
-        const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
-        const google::protobuf::Reflection* reflection = msg.GetReflection();
-        for(int i = 0; i != descriptor->field_count(); ++i) {
-            const google::protobuf::FieldDescriptor* field = descriptor->field(i);
-            if(field->is_repeated()) {
-                LOG_ERROR << "generate delete sql error: field can not be repeated, sql will be empty";
-                return "";
+std::string MysqlGenerator::GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context) const {
+    std::string sql;
+    GenerateSqlUpdateOnInsert(msg, context, sql);
+    return sql;
+}
+
+int MysqlGenerator::GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, std::string& sql) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element == nullptr) {
+        return GenerateSqlInsertSingle(*plan, context, msg, sql, true);
+    }
+    // one string can only hold one statement, rows setting different fields need the sink overload
+    MysqlSqlContext unlimited(context);
+    unlimited.maxPacketSize = std::string::npos;
+    int count = 0;
+    int ret = GenerateSqlUpdateOnInsert(msg, unlimited, [&count](const std::string&) {
+        return ++count == 1 ? 0 : SQL_GENERATE_EMPTY;
+    }, sql);
+    if(ret != 0) {
+        if(count > 1) {
+            LOG_ERROR << "generate multi update on insert sql error: rows need more than one statement, sql will be empty";
+        }
+        sql.clear();
+    }
+    return ret;
+}
+
+int MysqlGenerator::GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const {
+    std::string sql;
+    return GenerateSqlUpdateOnInsert(msg, context, sink, sql);
+}
+
+int MysqlGenerator::GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element == nullptr) {
+        int ret = GenerateSqlInsertSingle(*plan, context, msg, buffer, true);
+        return ret != 0 ? ret : sink(buffer);
+    }
+    const google::protobuf::Reflection* reflection = msg.GetReflection();
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan->columns[0].field);
+    if(repeatedMsg.empty()) {
+        LOG_ERROR << "generate multi update on insert sql error: repeated field is empty, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    return GenerateSqlUpdateOnInsertRows(*plan->element, context, repeatedMsg.data(), repeatedMsg.size(), sink, buffer);
+}
+
+// rows run through the groups of one segment in group order, not input order. a segment is closed as soon as
+// a primary key shows up again in another group, so a later row of the same key still overwrites an earlier one
+int MysqlGenerator::GenerateSqlUpdateOnInsertRows(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                                  const google::protobuf::Message* const* rows, int count, const SqlSink& sink, std::string& sql) const {
+    if(plan.hasRepeated) {
+        LOG_ERROR << "generate multi update on insert sql error: field can not be repeated, sql will be empty";
+        return SQL_GENERATE_EMPTY;
+    }
+    if(plan.columns.size() > 64) {
+        int generated = 0;
+        for(int r = 0; r != count; ++r) {
+            if(GenerateSqlInsertSingle(plan, context, *rows[r], sql, true) != 0) continue;
+            int ret = sink(sql);
+            if(ret != 0) return ret;
+            ++generated;
+        }
+        return generated == 0 ? SQL_GENERATE_EMPTY : 0;
+    }
+    const std::size_t columnCount = plan.columns.size();
+    RowGroups groups;
+    GroupRows(plan, GetCodec(plan), context, mHexMessage, rows, count, groups);
+    if(groups.skipped != 0) {
+        LOG_ERROR << "generate multi update on insert sql error: no field is setted, " << groups.skipped << " rows will be skipped";
+    }
+    if(groups.groups.empty()) return SQL_GENERATE_EMPTY;
+
+    // "insert into db.t (col1, col2) values " and " on duplicate key update col2 = values(col2)" of each group
+    std::vector<std::string> heads(groups.groups.size()), tails(groups.groups.size());
+    for(std::size_t g = 0; g != groups.groups.size(); ++g) {
+        std::string& head = heads[g];
+        std::string& tail = tails[g];
+        head = plan.target->insertInto;
+        for(std::size_t i = 0; i != columnCount; ++i) {
+            if((groups.masks[g] & (uint64_t(1) << i)) == 0) continue;
+            const MysqlColumn& column = plan.columns[i];
+            if(head.length() != plan.target->insertInto.length()) {
+                head.append(", ");
+            }
+            head.append(column.name);
+            if(column.primaryKey) continue;
+            tail.append(tail.empty() ? " on duplicate key update " : ", ");
+            tail.append(column.name).append(" = values(").append(column.name).append(")");
+        }
+        head.append(") values ");
+    }
+    std::vector<int> rowGroup(count, -1);
+    for(std::size_t g = 0; g != groups.groups.size(); ++g) {
+        for(std::size_t loop = 0; loop != groups.groups[g].size(); ++loop) {
+            rowGroup[groups.groups[g][loop]] = g;
+        }
+    }
+
+    const std::size_t limit = context.PacketLimit();
+    std::vector<std::vector<int>> segment(groups.groups.size());
+    auto flush = [&]() -> int {
+        for(std::size_t g = 0; g != segment.size(); ++g) {
+            const std::vector<int>& group = segment[g];
+            std::size_t begin = 0;
+            while(begin != group.size()) {
+                std::size_t end = begin, chunkSize = heads[g].length() + tails[g].length();
+                while(end != group.size() && (end == begin || chunkSize + groups.rowSizes[group[end]] <= limit)) {
+                    chunkSize += groups.rowSizes[group[end]];
+                    ++end;
+                }
+                sql.clear();
+                MysqlSqlBuilder builder(sql, context, mHexMessage);
+                builder.Reserve(chunkSize);
+                builder.Append(heads[g]);
+                for(std::size_t loop = begin; loop != end; ++loop) {
+                    const ValueSpan* rowSpans = &groups.spans[group[loop] * columnCount];
+                    builder.Append(loop == begin ? "(" : ", (");
+                    for(std::size_t i = 0, n = 0; i != columnCount; ++i) {
+                        if(rowSpans[i].length == std::string::npos) continue;
+                        if(n++ != 0) {
+                            builder.Append(", ");
+                        }
+                        builder.Append(groups.values.data() + rowSpans[i].offset, rowSpans[i].length);
+                    }
+                    builder.Append(')');
+                }
+                builder.Append(tails[g]);
+                MysqlGenerator::LogSql(sql);
+                int ret = sink(sql);
+                if(ret != 0) return ret;
+                begin = end;
             }
-            if(reflection->HasField(msg, field) == false) continue;
-            if(sqlCondition.empty()) {
-                sqlCondition += " where ";
-            } else {
-                sqlCondition += " and ";
+            segment[g].clear();
+        }
+        return 0;
+    };
+
+    std::unordered_map<std::string, int> keyGroup;
+    std::string key;
+    for(int r = 0; r != count; ++r) {
+        const int g = rowGroup[r];
+        if(g < 0) continue;
+        // primary key of the row, rows not setting all of it never hit an existing row by it
+        key.clear();
+        bool hasKey = false;
+        const ValueSpan* rowSpans = &groups.spans[r * columnCount];
+        for(std::size_t i = 0; i != columnCount; ++i) {
+            if(plan.columns[i].primaryKey == false) continue;
+            hasKey = rowSpans[i].length != std::string::npos;
+            if(hasKey == false) break;
+            key.append(groups.values, rowSpans[i].offset, rowSpans[i].length).push_back('\0');
+        }
+        if(hasKey) {
+            auto it = keyGroup.find(key);
+            if(it != keyGroup.end() && it->second != g) {
+                int ret = flush();
+                if(ret != 0) return ret;
+                keyGroup.clear();
+                it = keyGroup.end();
             }
-            sqlCondition += field->name() + " = " + MysqlGenerator::GetFieldValue(reflection, msg, field);
+            if(it == keyGroup.end()) {
+                keyGroup.insert(std::make_pair(key, g));
+            }
+        }
+        segment[g].push_back(r);
+    }
+    return flush();
+}
+
+int MysqlGenerator::GenerateSqlDeleteSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const {
+    sql.clear();
+    MysqlSqlBuilder builder(sql, context, mHexMessage);
+    builder.Reserve(plan.target->deleteFrom.length() + plan.rowWidth + mWhereClause.length() + 8);
+    builder.Append(plan.target->deleteFrom);
+    if(mWhere.empty()) {
+        if(plan.hasRepeated) {
+            LOG_ERROR << "generate delete sql error: field can not be repeated, sql will be empty";
+            sql.clear();
+            return SQL_GENERATE_EMPTY;
         }
-        if(sqlCondition.empty()) {
+        const std::size_t defaultSqlLength = builder.Length();
+        const MysqlCodec& codec = GetCodec(plan);
+        for(std::size_t i = 0; i != plan.columns.size(); ++i) {
+            const MysqlColumn& column = plan.columns[i];
+            if(codec.HasColumn(msg, i) == false) continue;
+            builder.Append(builder.Length() == defaultSqlLength ? " where " : " and ");
+            builder.Append(column.name).Append(" = ");
+            codec.AppendColumn(builder, msg, i);
+        }
+        if(builder.Length() == defaultSqlLength) {
             LOG_ERROR << "generate delete sql error: all fields are empty, sql will be empty";
-            return "";
+            sql.clear();
+            return SQL_GENERATE_EMPTY;
         }
-        sql += sqlCondition;
     } else {
-        sql += " " + mWhere;
+        builder.Append(mWhereClause);
     }
 
     MysqlGenerator::LogSql(sql);
-    return sql;
+    return 0;
 }
 
-std::vector<std::string> MysqlGenerator::GenerateSqlDeleteMulti(const google::protobuf::Message& msg) const {
-    std::vector<std::string> sqls;
-    const google::protobuf::Descriptor* descriptor = msg.GetDescriptor();
+int MysqlGenerator::GenerateSqlDeleteMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                           const SqlSink& sink, std::string& sql) const {
     const google::protobuf::Reflection* reflection = msg.GetReflection();
-    if(descriptor->field_count() == 0) {
-        LOG_ERROR << "generate multi delete sql error: msg is empty, sql will be empty";
-        return sqls;
-    }
-    const google::protobuf::FieldDescriptor* field = descriptor->field(0);
-    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, field);
+    const google::protobuf::RepeatedPtrField<google::protobuf::Message>& repeatedMsg = reflection->GetRepeatedPtrField<google::protobuf::Message>(msg, plan.columns[0].field);
     if(repeatedMsg.empty()) {
         LOG_ERROR << "generate multi delete sql error: repeated filed is empty, sql will be empty";
-        return sqls;
+        return SQL_GENERATE_EMPTY;
+    }
+    if(mWhere.empty() && !plan.element->hasRepeated && plan.element->columns.size() <= 64) {
+        return GenerateSqlDeleteBatch(*plan.element, context, repeatedMsg, sink, sql);
     }
+    int generated = 0;
     for(int i = 0; i != repeatedMsg.size(); ++i) {
-        std::string sql = GenerateSqlDeleteSingle(repeatedMsg[i]);
-        if(!sql.empty()) {
-            sqls.push_back(sql);
+        if(GenerateSqlDeleteSingle(*plan.element, context, repeatedMsg[i], sql) != 0) continue;
+        int ret = sink(sql);
+        if(ret != 0) return ret;
+        ++generated;
+    }
+    return generated == 0 ? SQL_GENERATE_EMPTY : 0;
+}
+
+// rows setting the same columns share one "delete from db.t where col in (...)",
+// or "where (col1, col2) in ((a, b), ...)" when more than one column is set
+int MysqlGenerator::GenerateSqlDeleteBatch(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                           const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, const SqlSink& sink, std::string& sql) const {
+    RowGroups groups;
+    GroupRows(plan, GetCodec(plan), context, mHexMessage, rows.data(), rows.size(), groups);
+    if(groups.skipped != 0) {
+        LOG_ERROR << "generate delete sql error: all fields are empty, " << groups.skipped << " rows will be skipped";
+    }
+
+    const std::size_t limit = context.PacketLimit();
+    const std::size_t headLength = plan.target->deleteFrom.length() + plan.allColumns.length() + 16;
+    for(std::size_t g = 0; g != groups.groups.size(); ++g) {
+        const std::vector<int>& group = groups.groups[g];
+        std::size_t begin = 0;
+        while(begin != group.size()) {
+            std::size_t end = begin, chunkSize = headLength;
+            while(end != group.size() && (end == begin || chunkSize + groups.rowSizes[group[end]] <= limit)) {
+                chunkSize += groups.rowSizes[group[end]];
+                ++end;
+            }
+            sql.clear();
+            MysqlSqlBuilder builder(sql, context, mHexMessage);
+            builder.Reserve(chunkSize);
+            builder.Append(plan.target->deleteFrom).Append(" where ");
+            AppendInList(builder, plan, groups, g, begin, end);
+            MysqlGenerator::LogSql(sql);
+            int ret = sink(sql);
+            if(ret != 0) return ret;
+            begin = end;
         }
     }
-    return sqls;
+    return groups.groups.empty() ? SQL_GENERATE_EMPTY : 0;
 }
 
 std::vector<std::string> MysqlGenerator::GenerateSqlDelete(const google::protobuf::Message& msg) const {
-    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(msg)) {
-        return GenerateSqlDeleteMulti(msg);
-    } else {
-        std::vector<std::string> vec;
-        std::string sql = GenerateSqlDeleteSingle(msg);
-        if(!sql.empty()) {
-            vec.push_back(sql);
+    return GenerateSqlDelete(msg, MysqlSqlContext());
+}
+
+std::vector<std::string> MysqlGenerator::GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context) const {
+    std::vector<std::string> sqls;
+    GenerateSqlDelete(msg, context, [&sqls](const std::string& sql) {
+        sqls.push_back(sql);
+        return 0;
+    });
+    return sqls;
+}
+
+int MysqlGenerator::GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const {
+    std::string sql;
+    return GenerateSqlDelete(msg, context, sink, sql);
+}
+
+int MysqlGenerator::GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element != nullptr) {
+        return GenerateSqlDeleteMulti(*plan, context, msg, sink, buffer);
+    }
+    int ret = GenerateSqlDeleteSingle(*plan, context, msg, buffer);
+    return ret != 0 ? ret : sink(buffer);
+}
+
+const MysqlPlan* MysqlGenerator::GetRowShape(const google::protobuf::Message& msg, uint64_t& mask) const {
+    const MysqlPlan* plan = GetPlan(msg);
+    if(plan->element != nullptr || plan->hasRepeated || plan->columns.size() > 64) return nullptr;
+    const MysqlCodec& codec = GetCodec(*plan);
+    mask = 0;
+    for(std::size_t i = 0; i != plan->columns.size(); ++i) {
+        if(codec.HasColumn(msg, i)) {
+            mask |= uint64_t(1) << i;
         }
-        return vec;
     }
+    return plan;
 }
 
-std::string MysqlGenerator::GetFieldValue(const google::protobuf::Reflection* reflection,
-                                          const google::protobuf::Message& msg,
-                                          const google::protobuf::FieldDescriptor* field) {
-    std::string result;
-    if(field->is_repeated()) return result;
-    switch (field->cpp_type()) {
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
-            result = boost::lexical_cast<std::string>(reflection->GetInt32(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
-            result = boost::lexical_cast<std::string>(reflection->GetInt64(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
-            result = boost::lexical_cast<std::string>(reflection->GetUInt32(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
-            result = boost::lexical_cast<std::string>(reflection->GetUInt64(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
-            result = boost::lexical_cast<std::string>(reflection->GetDouble(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
-            result = boost::lexical_cast<std::string>(reflection->GetFloat(msg, field));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
-            result = reflection->GetBool(msg, field) ? "1" : "0";
+// same statements as the text generators, with every value replaced by '?'
+int MysqlGenerator::GenerateStatement(StatementType type, const MysqlPlan& plan, uint64_t mask, std::string& sql, std::vector<int>& columns) const {
+    sql.clear();
+    columns.clear();
+    MysqlSqlBuilder builder(sql);
+    const std::size_t columnCount = plan.columns.size();
+    switch (type) {
+        case STATEMENT_SELECT:
+            {
+                const uint64_t all = columnCount == 64 ? ~uint64_t(0) : (uint64_t(1) << columnCount) - 1;
+                if(mask == all) {
+                    LOG_ERROR << "generate select statement error: all fields are not empty, sql will be empty";
+                    return SQL_GENERATE_EMPTY;
+                }
+                if(mask == 0) {
+                    builder.Append(plan.selectAll).Append(mWhereClause);
+                    break;
+                }
+                builder.Append("select ");
+                bool first = true;
+                for(std::size_t i = 0; i != columnCount; ++i) {
+                    if((mask & (uint64_t(1) << i)) != 0) continue;
+                    if(!first) {
+                        builder.Append(", ");
+                    }
+                    builder.Append(plan.columns[i].name);
+                    first = false;
+                }
+                builder.Append(plan.target->selectFrom);
+                if(mWhere.empty()) {
+                    for(std::size_t i = 0; i != columnCount; ++i) {
+                        if((mask & (uint64_t(1) << i)) == 0) continue;
+                        builder.Append(columns.empty() ? " where " : " and ");
+                        builder.Append(plan.columns[i].name).Append(" = ?");
+                        columns.push_back(i);
+                    }
+                } else {
+                    builder.Append(mWhereClause);
+                }
+            }
             break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
-            result = boost::lexical_cast<std::string>(reflection->GetEnumValue(msg, field));
+        case STATEMENT_INSERT:
+        case STATEMENT_UPDATE_ON_INSERT:
+            {
+                if(mask == 0) {
+                    LOG_ERROR << "generate insert statement error: no field is setted, sql will be empty";
+                    return SQL_GENERATE_EMPTY;
+                }
+                builder.Append(plan.target->insertInto);
+                for(std::size_t i = 0; i != columnCount; ++i) {
+                    if((mask & (uint64_t(1) << i)) == 0) continue;
+                    if(!columns.empty()) {
+                        builder.Append(", ");
+                    }
+                    builder.Append(plan.columns[i].name);
+                    columns.push_back(i);
+                }
+                builder.Append(") values (?");
+                for(std::size_t i = 1; i != columns.size(); ++i) {
+                    builder.Append(", ?");
+                }
+                builder.Append(')');
+                if(type == STATEMENT_UPDATE_ON_INSERT) {
+                    bool first = true;
+                    for(std::size_t i = 0; i != columnCount; ++i) {
+                        const MysqlColumn& column = plan.columns[i];
+                        if(column.primaryKey || (mask & (uint64_t(1) << i)) == 0) continue;
+                        builder.Append(first ? " on duplicate key update " : ", ");
+                        builder.Append(column.name).Append(" = values(").Append(column.name).Append(')');
+                        first = false;
+                    }
+                }
+            }
             break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+        case STATEMENT_UPDATE:
             {
-                result = reflection->GetString(msg, field);
-                char* tmp = new char[result.length()];
-                mysql_escape_string(tmp, result.c_str(), result.length());
-                result = std::string("'") +  tmp + "'";
-                delete [] tmp;
+                if(plan.hasUpdateKey == false && mWhere.empty()) {
+                    LOG_ERROR << "generate update statement error: not found option 'updatekey' and where condtion is emtpy, sql will be emtpy";
+                    return SQL_GENERATE_EMPTY;
+                }
+                builder.Append(plan.target->updateSet);
+                for(std::size_t i = 0; i != columnCount; ++i) {
+                    const MysqlColumn& column = plan.columns[i];
+                    if((mask & (uint64_t(1) << i)) == 0) {
+                        if(column.updateKey && mWhere.empty()) {
+                            LOG_ERROR << "generate update statement error: filed with option 'updatekey' can not be empty, sql will be empty";
+                            sql.clear();
+                            columns.clear();
+                            return SQL_GENERATE_EMPTY;
+                        }
+                        continue;
+                    }
+                    if(column.updateKey && mWhere.empty()) continue;
+                    if(!columns.empty()) {
+                        builder.Append(", ");
+                    }
+                    builder.Append(column.name).Append(" = ?");
+                    columns.push_back(i);
+                }
+                if(columns.empty()) {
+                    LOG_ERROR << "generate update statement error: no field to update, sql will be empty";
+                    sql.clear();
+                    return SQL_GENERATE_EMPTY;
+                }
+                if(mWhere.empty()) {
+                    bool first = true;
+                    for(std::size_t i = 0; i != columnCount; ++i) {
+                        const MysqlColumn& column = plan.columns[i];
+                        if(column.updateKey == false) continue;
+                        builder.Append(first ? " where " : " and ");
+                        builder.Append(column.name).Append(" = ?");
+                        columns.push_back(i);
+                        first = false;
+                    }
+                } else {
+                    builder.Append(mWhereClause);
+                }
             }
             break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+        case STATEMENT_DELETE:
             {
-                result = reflection->GetMessage(msg, field).SerializeAsString();
-                char* tmp = new char[result.length()];
-                mysql_escape_string(tmp, result.c_str(), result.length());
-                result = std::string("'") + tmp + "'";
-                delete [] tmp;
+                builder.Append(plan.target->deleteFrom);
+                if(mWhere.empty()) {
+                    for(std::size_t i = 0; i != columnCount; ++i) {
+                        if((mask & (uint64_t(1) << i)) == 0) continue;
+                        builder.Append(columns.empty() ? " where " : " and ");
+                        builder.Append(plan.columns[i].name).Append(" = ?");
+                        columns.push_back(i);
+                    }
+                    if(columns.empty()) {
+                        LOG_ERROR << "generate delete statement error: all fields are empty, sql will be empty";
+                        sql.clear();
+                        return SQL_GENERATE_EMPTY;
+                    }
+                } else {
+                    builder.Append(mWhereClause);
+                }
             }
             break;
         default:
-            break;
+            return SQL_GENERATE_EMPTY;
     }
+    MysqlGenerator::LogSql(sql);
+    return 0;
+}
+
+std::string MysqlGenerator::GetFieldValue(const google::protobuf::Reflection* reflection,
+                                          const google::protobuf::Message& msg,
+                                          const google::protobuf::FieldDescriptor* field) {
+    std::string result;
+    MysqlSqlBuilder(result).AppendFieldValue(reflection, msg, field);
     return result;
 }
 
-void MysqlGenerator::SetFieldValue(const char* rowdata, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result) {
-    if(field->is_repeated()) return;
-    const google::protobuf::Reflection* reflection = result.GetReflection();
-    switch (field->cpp_type()) {
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
-            reflection->SetInt32(&result, field, boost::lexical_cast<int32_t>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
-            reflection->SetInt64(&result, field, boost::lexical_cast<int64_t>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
-            reflection->SetUInt32(&result, field, boost::lexical_cast<uint32_t>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
-            reflection->SetUInt64(&result, field, boost::lexical_cast<uint64_t>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
-            reflection->SetDouble(&result, field, boost::lexical_cast<double>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
-            reflection->SetFloat(&result, field, boost::lexical_cast<float>(rowdata));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
-            reflection->SetBool(&result, field, boost::lexical_cast<int>(rowdata) ? true : false);
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
-            reflection->SetEnum(&result, field, field->enum_type()->FindValueByNumber(boost::lexical_cast<int>(rowdata)));
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
-            reflection->SetString(&result, field, rowdata);
-            break;
-        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
-            {
-                const google::protobuf::Descriptor* subDescriptor = field->message_type();
-                const google::protobuf::Message* protoType = google::protobuf::MessageFactory::generated_factory()->GetPrototype(subDescriptor);
-                google::protobuf::Message* subMsg = protoType->New();
-                subMsg->ParseFromArray(rowdata, strlen(rowdata));
-                reflection->SetAllocatedMessage(&result, subMsg, field);
-            }
-            break;
-        default:
-            break;
-    }
+bool MysqlGenerator::SetFieldValue(const char* rowdata, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result) {
+    return MysqlGenerator::SetFieldValue(rowdata, rowdata != nullptr ? strlen(rowdata) : 0, field, result);
 }
 
-void MysqlGenerator::ApplySelectResult(google::protobuf::Message& result, const char* rowdata, MYSQL_FIELD* field) {
+bool MysqlGenerator::SetFieldValue(const char* rowdata, unsigned long length, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result) {
+    return MysqlCodec::GetReflectionCodec(field->containing_type()).SetColumn(result, field->index(), rowdata, length);
+}
+
+bool MysqlGenerator::ApplySelectResult(google::protobuf::Message& result, const char* rowdata, MYSQL_FIELD* field) {
+    return MysqlGenerator::ApplySelectResult(result, rowdata, rowdata != nullptr ? strlen(rowdata) : 0, field);
+}
+
+bool MysqlGenerator::ApplySelectResult(google::protobuf::Message& result, const char* rowdata, unsigned long length, MYSQL_FIELD* field) {
     const google::protobuf::FieldDescriptor* fieldDescriptor = result.GetDescriptor()->FindFieldByName(field->name);
-    if(fieldDescriptor != nullptr) {
-        MysqlGenerator::SetFieldValue(rowdata, fieldDescriptor, result);
-    }
+    if(fieldDescriptor == nullptr) return true;
+    return MysqlGenerator::SetFieldValue(rowdata, length, fieldDescriptor, result);
 }
 
 bool MysqlGenerator::OnlyHoldsOneRepeatedMessageField(const google::protobuf::Message& msg) {
@@ -3,11 +3,14 @@
 
 #include <string>
 #include <vector>
+#include <functional>
+#include <stdint.h>
 #include <mysql/mysql.h>
 
 namespace google {
     namespace protobuf {
         class Message;
+        class Descriptor;
         template<typename T>
         class RepeatedPtrField;
         class Reflection;
@@ -16,13 +19,59 @@ namespace google {
 }
 
 namespace soul {
+    struct MysqlTarget;
+    struct MysqlPlan;
+    struct MysqlSqlContext;
+    class MysqlCodec;
+
+    // rows of a multi key select mapped back to the elements that requested them.
+    // rows are matched by the text their key columns format to, not by the server's comparison: a string key
+    // matched through a case or accent insensitive collation (or trailing space padding) does not map back,
+    // its element is reported missing
+    struct MysqlSelectMapping {
+        std::vector<int> rowRequest;    // lowest requesting element of each result row, -1 if none matches
+        std::vector<int> missing;       // requesting elements without any result row
+    };
+
     class MysqlGenerator {
         private:
             const std::string mDataBase;
             const std::string mTable;
             std::string mWhere;
+            std::string mWhereClause;       // " " + where, empty if no where condition
+            const MysqlTarget* mTarget;
+            const MysqlPlan* mPlan;
+            bool mHexMessage;
+            bool mGeneratedCodec;
+            bool mBatchUpdate;
         public:
+            enum MessageEncoding {
+                MESSAGE_ESCAPE,     // '...' escaped serialized bytes
+                MESSAGE_HEX,        // X'...' hex literal of serialized bytes
+            };
+            enum UpdateMode {
+                UPDATE_PER_ROW,     // one update statement per repeated element
+                UPDATE_BATCH,       // one update ... set col = case ... where key in (...) per max_allowed_packet
+            };
+            enum StatementType {
+                STATEMENT_SELECT,
+                STATEMENT_INSERT,
+                STATEMENT_UPDATE,
+                STATEMENT_UPDATE_ON_INSERT,
+                STATEMENT_DELETE,
+            };
+            // receives each generated statement, a non-zero return stops the generation and is passed back
+            typedef std::function<int(const std::string& sql)> SqlSink;
             MysqlGenerator(const std::string& database, const std::string& table, const std::string& where = "");
+            void SetMessageEncoding(MessageEncoding encoding);
+            // use the protoc-gen-mysql codec of a message type when one is linked in, default on
+            void SetGeneratedCodec(bool on);
+            void SetUpdateMode(UpdateMode mode);
+            // resolve the plan of a message type once, later calls with that type skip the plan cache lookup
+            void SetMessageType(const google::protobuf::Descriptor* descriptor);
+            const MysqlCodec& GetCodec(const google::protobuf::Descriptor* descriptor) const;
+            // trimmed where condition, empty if none
+            const std::string& Where() const { return mWhere; }
 
             std::string GenerateSqlSelect(const google::protobuf::Message& msg) const;
             std::string GenerateSqlInsert(const google::protobuf::Message& msg) const;
@@ -30,24 +79,81 @@ namespace soul {
             std::string GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg) const;
             std::vector<std::string> GenerateSqlDelete(const google::protobuf::Message& msg) const;
 
+            std::string GenerateSqlSelect(const google::protobuf::Message& msg, const MysqlSqlContext& context) const;
+            std::string GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context) const;
+            std::vector<std::string> GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context) const;
+            std::string GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context) const;
+            std::vector<std::string> GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context) const;
+
+            // the statement is written into sql, whose capacity is kept, so a buffer reused across calls
+            // stops allocating once it is large enough. return 0 or SQL_GENERATE_EMPTY
+            int GenerateSqlSelect(const google::protobuf::Message& msg, const MysqlSqlContext& context, std::string& sql) const;
+            int GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, std::string& sql) const;
+
+            // statements of multi row messages are split to fit context.maxPacketSize, each one is handed
+            // to sink as soon as it is complete so only one statement is held in memory.
+            // return 0, SQL_GENERATE_EMPTY or the first non-zero sink result
+            int GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const;
+            int GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const;
+            // multi row upserts group the rows by the fields they set, each group becomes
+            // insert ... values (...), (...) on duplicate key update col = values(col)
+            int GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const;
+            int GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink) const;
+
+            // same as above, every statement is built in buffer and sink receives buffer itself
+            int GenerateSqlInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const;
+            int GenerateSqlUpdate(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const;
+            int GenerateSqlUpdateOnInsert(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const;
+            int GenerateSqlDelete(const google::protobuf::Message& msg, const MysqlSqlContext& context, const SqlSink& sink, std::string& buffer) const;
+
+            // plan of a single row message and the columns it sets, bit i is column i.
+            // nullptr if msg can not be bound as one row: repeated fields or more than 64 columns
+            const MysqlPlan* GetRowShape(const google::protobuf::Message& msg, uint64_t& mask) const;
+            // statement of one row shape with a '?' placeholder for every value, columns receives the column
+            // bound to each placeholder in order. return 0 or SQL_GENERATE_EMPTY
+            int GenerateStatement(StatementType type, const MysqlPlan& plan, uint64_t mask, std::string& sql, std::vector<int>& columns) const;
+
+            // request is the repeated message the select was generated from, result the one holding the rows
+            void MapSelectResult(const google::protobuf::Message& request, const google::protobuf::Message& result, MysqlSelectMapping& mapping) const;
+
         public:
             static std::string GetFieldValue(const google::protobuf::Reflection* reflection,
                                           const google::protobuf::Message& msg,
                                           const google::protobuf::FieldDescriptor* field);
-            static void SetFieldValue(const char* rowdata, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result);
-            static void ApplySelectResult(google::protobuf::Message& result, const char* rowdata, MYSQL_FIELD* field);
+            // one text protocol cell, NULL rowdata leaves the field unset. return false if the cell is no valid value
+            // of the field. the overloads without length stop at the first NUL, blobs need the length from
+            // mysql_fetch_lengths. a whole result set is decoded faster by MysqlRowDecoder
+            static bool SetFieldValue(const char* rowdata, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result);
+            static bool SetFieldValue(const char* rowdata, unsigned long length, const google::protobuf::FieldDescriptor* field, google::protobuf::Message& result);
+            static bool ApplySelectResult(google::protobuf::Message& result, const char* rowdata, MYSQL_FIELD* field);
+            static bool ApplySelectResult(google::protobuf::Message& result, const char* rowdata, unsigned long length, MYSQL_FIELD* field);
             static bool OnlyHoldsOneRepeatedMessageField(const google::protobuf::Message& msg);
             static void TrimString(std::string& str);
         private:
-            std::string GenerateSqlSelectSingle(const google::protobuf::Message& msg) const;
-            std::string GenerateSqlSelectMulti(const google::protobuf::Message& msg) const;
-            int GenerateSqlSelectImpl(const google::protobuf::Message& msg, std::string& sql, bool selectAll) const;
-            std::string GenerateSqlInsertSingle(const google::protobuf::Message& msg, bool update = false) const;
-            std::string GenerateSqlInsertMulti(const google::protobuf::Message& msg) const;
-            std::string GenerateSqlUpdateSingle(const google::protobuf::Message& msg) const;
-            std::vector<std::string> GenerateSqlUpdateMulti(const google::protobuf::Message& msg) const;
-            std::string GenerateSqlDeleteSingle(const google::protobuf::Message& msg) const;
-            std::vector<std::string> GenerateSqlDeleteMulti(const google::protobuf::Message& msg) const;
+            const MysqlPlan* GetPlan(const google::protobuf::Message& msg) const;
+            const MysqlCodec& GetCodec(const MysqlPlan& plan) const;
+            int GenerateSqlSelectSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlSelectMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlSelectKeys(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                      const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, std::string& sql) const;
+            int GenerateSqlSelectImpl(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlInsertSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                        std::string& sql, bool update = false) const;
+            int GenerateSqlInsertMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlInsertRows(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                      const google::protobuf::Message* const* rows, int count, const SqlSink& sink, std::string& sql) const;
+            int GenerateSqlUpdateOnInsertRows(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                              const google::protobuf::Message* const* rows, int count, const SqlSink& sink, std::string& sql) const;
+            int GenerateSqlUpdateSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlUpdateMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                       const SqlSink& sink, std::string& sql) const;
+            int GenerateSqlUpdateBatch(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                       const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, const SqlSink& sink, std::string& sql) const;
+            int GenerateSqlDeleteSingle(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg, std::string& sql) const;
+            int GenerateSqlDeleteMulti(const MysqlPlan& plan, const MysqlSqlContext& context, const google::protobuf::Message& msg,
+                                       const SqlSink& sink, std::string& sql) const;
+            int GenerateSqlDeleteBatch(const MysqlPlan& plan, const MysqlSqlContext& context,
+                                       const google::protobuf::RepeatedPtrField<google::protobuf::Message>& rows, const SqlSink& sink, std::string& sql) const;
             static void LogSql(const std::string& sql);
     };
 }
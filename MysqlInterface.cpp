@@ -1,15 +1,23 @@
 #include <soul/protobuf-mysql/MysqlInterface.h>
 #include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
 #include <soul/protobuf-mysql/MysqlError.h>
+#include <soul/protobuf-mysql/MysqlPlan.h>
 #include <soul/Log.h>
+#include <mysql/errmsg.h>
 #include <google/protobuf/message.h>
 #include <google/protobuf/repeated_field.h>
 #include <google/protobuf/reflection.h>
-#include <boost/lexical_cast.hpp>
+#include <google/protobuf/descriptor.h>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
 
 using namespace soul;
 
-MysqlInterface::MysqlInterface() : mAutoCommit(true) {
+MysqlInterface::MysqlInterface() : mAutoCommit(true), mAffectedRows(0), mPrepared(false), mMultiStatements(false), mFailedStatement(-1) {
     MYSQL* ret = mysql_init(&mSqlHandler);
     if(ret == nullptr) {
         LOG_ERROR << "mysql_init failed";
@@ -17,6 +25,7 @@ MysqlInterface::MysqlInterface() : mAutoCommit(true) {
 }
 
 MysqlInterface::~MysqlInterface() {
+    mStatements.Clear();
     mysql_close(&mSqlHandler);
 }
 
@@ -29,12 +38,97 @@ bool MysqlInterface::Connect(const char* host, uint16_t port, const char* user,
         LOG_DEBUG << "connected to mysql: " << host << " : " << port;
         char reconnect = 1;
         mysql_options(&mSqlHandler, MYSQL_OPT_RECONNECT, (char *)&(reconnect));
+        UpdateEscapeMode();
+        UpdateMaxPacketSize();
         return true;
     }
 }
 
+bool MysqlInterface::Ping() {
+    const unsigned long threadId = mysql_thread_id(&mSqlHandler);
+    if(mysql_ping(&mSqlHandler) != 0) {
+        SetErrorMsg();
+        LOG_WARN << "mysql_ping failed: " << LastError();
+        mStatements.Clear();
+        return false;
+    }
+    if(mysql_thread_id(&mSqlHandler) != threadId) {
+        // reconnected, the server side session is new
+        LOG_DEBUG << "mysql reconnected, thread id: " << mysql_thread_id(&mSqlHandler);
+        mStatements.Clear();
+        if(mAutoCommit == false) {
+            mysql_autocommit(&mSqlHandler, false);
+        }
+        if(mMultiStatements) {
+            mysql_set_server_option(&mSqlHandler, MYSQL_OPTION_MULTI_STATEMENTS_ON);
+        }
+        UpdateEscapeMode();
+    }
+    return true;
+}
+
+bool MysqlInterface::SetMultiStatements(bool on) {
+    if(mysql_set_server_option(&mSqlHandler, on ? MYSQL_OPTION_MULTI_STATEMENTS_ON : MYSQL_OPTION_MULTI_STATEMENTS_OFF) != 0) {
+        SetErrorMsg();
+        LOG_ERROR << "mysql_set_server_option failed: " << LastError();
+        return false;
+    }
+    mMultiStatements = on;
+    return true;
+}
+
+bool MysqlInterface::SetCharset(const char* charset) {
+    if(mysql_set_character_set(&mSqlHandler, charset) != 0) {
+        SetErrorMsg();
+        LOG_ERROR << "mysql_set_character_set failed: " << LastError();
+        return false;
+    }
+    UpdateEscapeMode();
+    return true;
+}
+
+void MysqlInterface::UpdateEscapeMode() {
+    const char* charset = mysql_character_set_name(&mSqlHandler);
+    if(charset != nullptr && MysqlSqlBuilder::IsEscapeSafeCharset(charset) == false) {
+        mContext.escapeConnection = &mSqlHandler;
+    } else {
+        mContext.escapeConnection = nullptr;
+    }
+}
+
+void MysqlInterface::UpdateMaxPacketSize() {
+    const char query[] = "select @@max_allowed_packet";
+    if(Query(query, sizeof(query) - 1) != 0) {
+        SetErrorMsg();
+        LOG_WARN << "read max_allowed_packet failed: " << LastError();
+        return;
+    }
+    MYSQL_RES* res = mysql_store_result(&mSqlHandler);
+    if(res == nullptr) return;
+    MYSQL_ROW row = mysql_fetch_row(res);
+    if(row != nullptr && row[0] != nullptr) {
+        unsigned long long size = strtoull(row[0], nullptr, 10);
+        if(size != 0) {
+            mContext.maxPacketSize = size;
+        }
+    }
+    mysql_free_result(res);
+}
+
 void MysqlInterface::SetAutoCommit(bool on) {
-    mAutoCommit = mysql_autocommit(&mSqlHandler, on);
+    if(mysql_autocommit(&mSqlHandler, on) == 0) {
+        mAutoCommit = on;
+    } else {
+        SetErrorMsg();
+        LOG_ERROR << "mysql_autocommit failed: " << LastError();
+    }
+}
+
+void MysqlInterface::SetPreparedStatement(bool on) {
+    mPrepared = on;
+    if(on == false) {
+        mStatements.Clear();
+    }
 }
 
 int MysqlInterface::SwitchDB(const char* db) {
@@ -46,14 +140,19 @@ int MysqlInterface::Query(const char* query, uint64_t len) {
 }
 
 bool MysqlInterface::Commit() {
-    if(mAutoCommit == false) {
-        return mysql_commit(&mSqlHandler);
+    if(mAutoCommit == false && mysql_commit(&mSqlHandler) != 0) {
+        LOG_ERROR << "commit failed: " << SetErrorMsg();
+        return false;
     }
     return true;
 }
 
 bool MysqlInterface::Rollback() {
-    return mysql_rollback(&mSqlHandler);
+    if(mysql_rollback(&mSqlHandler) != 0) {
+        LOG_ERROR << "rollback failed: " << SetErrorMsg();
+        return false;
+    }
+    return true;
 }
 
 const std::string MysqlInterface::LastError() const {
@@ -66,167 +165,499 @@ const std::string& MysqlInterface::SetErrorMsg() {
 }
 
 int MysqlInterface::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result) {
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const google::protobuf::Message* condition = nullptr;
+        bool multi = false;
+        const MysqlPlan* plan = GetSelectShape(generator, result, mask, condition, multi);
+        if(plan != nullptr) {
+            return ExecuteStatementSelect(generator, *plan, mask, *condition, result, multi);
+        }
+    }
     int ret = 0;
-    try {
-        std::string sql = generator.GenerateSqlSelect(result);
-        if(sql.empty()) return SQL_GENERATE_EMPTY;
-        ret = Query(sql.c_str(), sql.length());
-        if(ret != 0) {
+    if(generator.GenerateSqlSelect(result, mContext, mSqlBuffer) != 0) return SQL_GENERATE_EMPTY;
+    const std::string& sql = mSqlBuffer;
+    ret = Query(sql.c_str(), sql.length());
+    if(ret != 0) {
+        SetErrorMsg();
+        LOG_ERROR << LastError();
+    } else {
+        MYSQL_RES* res = mysql_store_result(&mSqlHandler);
+        if(res == nullptr) {
             SetErrorMsg();
             LOG_ERROR << LastError();
+            ret = mysql_errno(&mSqlHandler);
         } else {
-            MYSQL_RES* res = mysql_store_result(&mSqlHandler);
-            if(res == nullptr) {
-                SetErrorMsg();
-                LOG_ERROR << LastError();
-                ret = mysql_errno(&mSqlHandler);
+            my_ulonglong rowCount = mysql_num_rows(res);
+            if(rowCount == 0) {
+                ret = ER_KEY_NOT_FOUND;
             } else {
-                my_ulonglong rowCount = mysql_num_rows(res);
-                if(rowCount == 0) {
-                    ret = ER_KEY_NOT_FOUND;
+                MYSQL_ROW row;
+                bool multi = MysqlGenerator::OnlyHoldsOneRepeatedMessageField(result);
+                const google::protobuf::Descriptor* descriptor = result.GetDescriptor();
+                const google::protobuf::Descriptor* rowDescriptor = multi ? descriptor->field(0)->message_type() : descriptor;
+                uint32_t fieldCount = mysql_num_fields(res);
+                mDecoder.Reset(generator.GetCodec(rowDescriptor), rowDescriptor, mysql_fetch_fields(res), fieldCount);
+                if(multi) {
+                    result.Clear();
+                    const google::protobuf::Reflection* reflection = result.GetReflection();
+                    const google::protobuf::FieldDescriptor* field = descriptor->field(0);
+                    ReserveRows(result, field, rowCount);
+                    while(ret == 0 && (row = mysql_fetch_row(res)) != nullptr) {
+                        if(fieldCount == 0) continue;
+                        unsigned long* lengths = mysql_fetch_lengths(res);
+                        ret = ApplyRow(mDecoder, row, lengths, *reflection->AddMessage(&result, field));
+                    }
                 } else {
-                    MYSQL_ROW row;
-                    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(result)) {
-                        result.Clear();
-                        const google::protobuf::Descriptor* descriptor = result.GetDescriptor();
-                        const google::protobuf::Reflection* reflection = result.GetReflection();
-                        const google::protobuf::FieldDescriptor* field = descriptor->field(0);
-                        const google::protobuf::MutableRepeatedFieldRef<google::protobuf::Message> repeatedMsg 
-                                = reflection->GetMutableRepeatedFieldRef<google::protobuf::Message>(&result, field);
-                        while((row = mysql_fetch_row(res)) != nullptr) {
-                            uint32_t fieldCount = mysql_num_fields(res);
-                            if(fieldCount == 0) continue;
-                            google::protobuf::Message* subMsg = repeatedMsg.NewMessage();
-                            for(uint32_t i = 0; i!= fieldCount; ++i) {
-                                MysqlGenerator::ApplySelectResult(*subMsg, row[i], mysql_fetch_field_direct(res, i));
-                            }
-                            reflection->AddAllocatedMessage(&result, field, subMsg);
-                        }
-                    } else {
-                        if(rowCount > 1) {
-                            LOG_DEBUG << "select result rows: " << rowCount << ", use first one, sql: " << sql;
-                        }
-                        row = mysql_fetch_row(res);
-                        if(row != nullptr) {
-                            uint32_t fieldCount = mysql_num_fields(res);
-                            for(uint32_t i = 0; i != fieldCount; ++i) {
-                                MysqlGenerator::ApplySelectResult(result, row[i], mysql_fetch_field_direct(res, i));
-                            }
-                        }
+                    if(rowCount > 1) {
+                        LOG_DEBUG << "select result rows: " << rowCount << ", use first one, sql: " << sql;
+                    }
+                    row = mysql_fetch_row(res);
+                    if(row != nullptr) {
+                        ret = ApplyRow(mDecoder, row, mysql_fetch_lengths(res), result);
                     }
                 }
             }
-            mysql_free_result(res);
         }
-    } catch(boost::bad_lexical_cast& e) {
-        LOG_ERROR << "genrate select sql catch exception, what: " << e.what();
-        ret = SQL_GENERATE_FAIL;
+        mysql_free_result(res);
     }
 
     return ret;
 }
 
-int MysqlInterface::ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+int MysqlInterface::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, MysqlSelectMapping& mapping) {
+    std::unique_ptr<google::protobuf::Message> request(result.New());
+    request->CopyFrom(result);
+    int ret = ExecuteSqlSelect(generator, result);
+    if(ret == 0) {
+        generator.MapSelectResult(*request, result, mapping);
+    } else if(ret == ER_KEY_NOT_FOUND) {
+        std::unique_ptr<google::protobuf::Message> empty(result.New());
+        generator.MapSelectResult(*request, *empty, mapping);
+    }
+    return ret;
+}
+
+int MysqlInterface::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, int batchSize, const SelectHandler& handler) {
+    bool multi = MysqlGenerator::OnlyHoldsOneRepeatedMessageField(result);
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const google::protobuf::Message* condition = nullptr;
+        const MysqlPlan* plan = GetSelectShape(generator, result, mask, condition, multi);
+        if(plan != nullptr) {
+            MysqlStatement* statement = nullptr;
+            int ret = RunStatement(generator, MysqlGenerator::STATEMENT_SELECT, *plan, mask, *condition, statement);
+            if(ret != 0) return ret;
+            ret = StreamRows(result, multi, batchSize, handler, [statement](google::protobuf::Message& row) {
+                return statement->Fetch(row);
+            });
+            if(ret == SQL_DECODE_FAIL) {
+                LOG_ERROR << "decode select result failed, message: " << plan->descriptor->full_name();
+            } else if(ret != 0 && ret != ER_KEY_NOT_FOUND && mysql_stmt_errno(statement->Handle()) != 0) {
+                mErrorStr = statement->Error();
+                LOG_ERROR << "fetch statement result failed: " << mErrorStr;
+            }
+            statement->FreeResult();
+            return ret;
+        }
+    }
     int ret = 0;
-    try {
-        std::string sql = generator.GenerateSqlInsert(msg);
-        if(sql.empty()) return SQL_GENERATE_EMPTY;
-        ret = Query(sql.c_str(), sql.length());
+    if(generator.GenerateSqlSelect(result, mContext, mSqlBuffer) != 0) return SQL_GENERATE_EMPTY;
+    ret = Query(mSqlBuffer.c_str(), mSqlBuffer.length());
+    if(ret != 0) {
+        SetErrorMsg();
+        LOG_ERROR << LastError();
+        return ret;
+    }
+    MYSQL_RES* res = mysql_use_result(&mSqlHandler);
+    if(res == nullptr) {
+        SetErrorMsg();
+        LOG_ERROR << LastError();
+        return mysql_errno(&mSqlHandler);
+    }
+    const google::protobuf::Descriptor* descriptor = result.GetDescriptor();
+    const google::protobuf::Descriptor* rowDescriptor = multi ? descriptor->field(0)->message_type() : descriptor;
+    mDecoder.Reset(generator.GetCodec(rowDescriptor), rowDescriptor, mysql_fetch_fields(res), mysql_num_fields(res));
+    ret = StreamRows(result, multi, batchSize, handler, [this, res](google::protobuf::Message& row) {
+        MYSQL_ROW cells = mysql_fetch_row(res);
+        if(cells == nullptr) {
+            if(mysql_errno(&mSqlHandler) != 0) {
+                SetErrorMsg();
+                LOG_ERROR << "fetch select result failed: " << LastError();
+                return int(mysql_errno(&mSqlHandler));
+            }
+            return MYSQL_NO_DATA;
+        }
+        return ApplyRow(mDecoder, cells, mysql_fetch_lengths(res), row);
+    });
+    // rows left after an early stop are read and dropped here, the connection can not be used before
+    mysql_free_result(res);
+    return ret;
+}
+
+int MysqlInterface::StreamRows(google::protobuf::Message& result, bool multi, int batchSize, const SelectHandler& handler,
+                               const std::function<int(google::protobuf::Message& row)>& fetch) {
+    const google::protobuf::Reflection* reflection = result.GetReflection();
+    const google::protobuf::FieldDescriptor* field = multi ? result.GetDescriptor()->field(0) : nullptr;
+    if(multi) {
+        // cleared elements stay allocated and are reused by AddMessage, batches after the first allocate nothing
+        reflection->ClearField(&result, field);
+    }
+    if(batchSize <= 0) {
+        batchSize = 1;
+    }
+    int ret = 0, pending = 0;
+    bool found = false;
+    while(true) {
+        google::protobuf::Message& row = multi ? *reflection->AddMessage(&result, field) : result;
+        ret = fetch(row);
         if(ret != 0) {
+            if(multi) {
+                reflection->RemoveLast(&result, field);
+            }
+            break;
+        }
+        found = true;
+        if(multi && ++pending != batchSize) continue;
+        pending = 0;
+        ret = handler(result);
+        if(ret != 0) return ret;
+        if(multi) {
+            reflection->ClearField(&result, field);
+        }
+    }
+    if(ret != MYSQL_NO_DATA) return ret;
+    if(pending != 0) return handler(result);
+    return found ? 0 : ER_KEY_NOT_FOUND;
+}
+
+const MysqlPlan* MysqlInterface::GetSelectShape(const MysqlGenerator& generator, const google::protobuf::Message& result,
+                                                uint64_t& mask, const google::protobuf::Message*& condition, bool& multi) {
+    const MysqlPlan* plan = generator.GetRowShape(result, mask);
+    if(plan != nullptr) {
+        condition = &result;
+        multi = false;
+        return plan;
+    }
+    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(result) == false) return nullptr;
+    const google::protobuf::Reflection* reflection = result.GetReflection();
+    const google::protobuf::FieldDescriptor* field = result.GetDescriptor()->field(0);
+    if(reflection->FieldSize(result, field) != 1) return nullptr;
+    condition = &reflection->GetRepeatedMessage(result, field, 0);
+    multi = true;
+    return generator.GetRowShape(*condition, mask);
+}
+
+void MysqlInterface::ReserveRows(google::protobuf::Message& result, const google::protobuf::FieldDescriptor* field, my_ulonglong rowCount) {
+    google::protobuf::RepeatedPtrField<google::protobuf::Message>* rows
+            = result.GetReflection()->MutableRepeatedPtrField<google::protobuf::Message>(&result, field);
+    const my_ulonglong limit = std::numeric_limits<int>::max();
+    rows->Reserve(static_cast<int>(std::min(rowCount, limit)));
+}
+
+int MysqlInterface::ApplyRow(const MysqlRowDecoder& decoder, MYSQL_ROW row, unsigned long* lengths, google::protobuf::Message& result) {
+    MysqlDecodeStatus status;
+    if(decoder.Decode(row, lengths, result, status) != 0) {
+        LOG_ERROR << "decode select result failed, message: " << result.GetTypeName()
+                  << ", field: " << result.GetDescriptor()->field(status.field)->name();
+    }
+    return status.error;
+}
+
+int MysqlInterface::ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    mAffectedRows = 0;
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const MysqlPlan* plan = generator.GetRowShape(msg, mask);
+        if(plan != nullptr) {
+            return ExecuteStatement(generator, MysqlGenerator::STATEMENT_INSERT, *plan, mask, msg);
+        }
+    }
+    int ret = 0;
+    ret = generator.GenerateSqlInsert(msg, mContext, [this](const std::string& sql) {
+        int queryRet = Query(sql.c_str(), sql.length());
+        if(queryRet != 0) {
             SetErrorMsg();
             LOG_ERROR << LastError() << ", sql: " << sql;
-            return ret;
-        }
-        my_ulonglong affected = mysql_affected_rows(&mSqlHandler);
-        if(affected == 0) {
-            LOG_DEBUG << "insert affected no rows, sql: " << sql;
-        } else {
-            LOG_DEBUG << "affect rows: " << affected << ", sql: " << sql;
+            if(mAutoCommit == false) {
+                LOG_WARN << "insert rollback";
+            }
+            return queryRet;
         }
-    } catch(boost::bad_lexical_cast& e) {
-        LOG_ERROR << "generate insert sql catch exception, what: " << e.what();
-        ret = SQL_GENERATE_FAIL;
+        mAffectedRows += mysql_affected_rows(&mSqlHandler);
+        return 0;
+    }, mSqlBuffer);
+    if(ret == 0) {
+        LOG_DEBUG << "insert total affect rows: " << mAffectedRows;
     }
 
     return ret;
 }
 
 int MysqlInterface::ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    mAffectedRows = 0;
+    mFailedStatement = -1;
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const MysqlPlan* plan = generator.GetRowShape(msg, mask);
+        if(plan != nullptr) {
+            return ExecuteStatement(generator, MysqlGenerator::STATEMENT_UPDATE, *plan, mask, msg);
+        }
+    }
+    if(mMultiStatements) {
+        return ExecuteMultiStatements("update", [this, &generator, &msg](const MysqlGenerator::SqlSink& sink) {
+            return generator.GenerateSqlUpdate(msg, mContext, sink, mSqlBuffer);
+        });
+    }
     int ret = 0;
-    try {
-        std::vector<std::string> sqls = generator.GenerateSqlUpdate(msg);
-        if(sqls.empty()) return SQL_GENERATE_EMPTY;
-        my_ulonglong affected = 0;
-        for(int i = 0; i != sqls.size(); ++i) {
-            const std::string& sql = sqls[i];
-            ret = Query(sql.c_str(), sql.length());
-            if(ret) {
-                SetErrorMsg();
-                LOG_WARN << "update query error: " << LastError() << ", sql: " << sql;
-                if(mAutoCommit == false) {
-                    LOG_WARN << "update rollback";
-                    return ret;
-                }
-            } else {
-                affected += mysql_affected_rows(&mSqlHandler);
+    int index = 0;
+    int generateRet = generator.GenerateSqlUpdate(msg, mContext, [this, &ret, &index](const std::string& sql) {
+        ret = Query(sql.c_str(), sql.length());
+        ++index;
+        if(ret) {
+            SetErrorMsg();
+            if(mFailedStatement < 0) {
+                mFailedStatement = index - 1;
+            }
+            LOG_WARN << "update query error: " << LastError() << ", sql: " << sql;
+            if(mAutoCommit == false) {
+                LOG_WARN << "update rollback";
+                return ret;
             }
+        } else {
+            mAffectedRows += mysql_affected_rows(&mSqlHandler);
         }
-        LOG_DEBUG << "update total affect rows: " << affected;
-    } catch(boost::bad_lexical_cast& e) {
-        LOG_ERROR << "generate insert sql catch exception, what: " << e.what();
-        ret = SQL_GENERATE_FAIL;
-    }
+        return 0;
+    }, mSqlBuffer);
+    if(generateRet == SQL_GENERATE_EMPTY) return SQL_GENERATE_EMPTY;
+    if(ret && mAutoCommit == false) return ret;
+    LOG_DEBUG << "update total affect rows: " << mAffectedRows;
 
     return ret;
 }
 
 int MysqlInterface::ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    mAffectedRows = 0;
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const MysqlPlan* plan = generator.GetRowShape(msg, mask);
+        if(plan != nullptr) {
+            return ExecuteStatement(generator, MysqlGenerator::STATEMENT_UPDATE_ON_INSERT, *plan, mask, msg);
+        }
+    }
     int ret = 0;
-    try {
-        std::string sql = generator.GenerateSqlUpdateOnInsert(msg);
-        if(sql.empty()) return SQL_GENERATE_EMPTY;
-        ret = Query(sql.c_str(), sql.length());
-        if(ret != 0) {
+    ret = generator.GenerateSqlUpdateOnInsert(msg, mContext, [this](const std::string& sql) {
+        int queryRet = Query(sql.c_str(), sql.length());
+        if(queryRet != 0) {
             SetErrorMsg();
             LOG_ERROR << LastError() << ", sql: " << sql;
-            return ret;
+            return queryRet;
         }
-        my_ulonglong affected = mysql_affected_rows(&mSqlHandler);
-        if(affected == 0) {
-            LOG_DEBUG << "update on insert affected no rows, sql: " << sql;
+        mAffectedRows += mysql_affected_rows(&mSqlHandler);
+        return 0;
+    }, mSqlBuffer);
+    if(ret == 0) {
+        if(mAffectedRows == 0) {
+            LOG_DEBUG << "update on insert affected no rows";
         } else {
-            LOG_DEBUG << "affect rows: " << affected << ", sql: " << sql;
+            LOG_DEBUG << "update on insert total affect rows: " << mAffectedRows;
         }
-    } catch(boost::bad_lexical_cast& e) {
-        LOG_ERROR << "generate insert sql catch exception, what: " << e.what();
-        ret = SQL_GENERATE_FAIL;
     }
 
     return ret;
 }
 
 int MysqlInterface::ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg) {
+    mAffectedRows = 0;
+    mFailedStatement = -1;
+    if(mPrepared) {
+        uint64_t mask = 0;
+        const MysqlPlan* plan = generator.GetRowShape(msg, mask);
+        if(plan != nullptr) {
+            return ExecuteStatement(generator, MysqlGenerator::STATEMENT_DELETE, *plan, mask, msg);
+        }
+    }
+    if(mMultiStatements) {
+        return ExecuteMultiStatements("delete", [this, &generator, &msg](const MysqlGenerator::SqlSink& sink) {
+            return generator.GenerateSqlDelete(msg, mContext, sink, mSqlBuffer);
+        });
+    }
     int ret = 0;
-    try {
-        std::vector<std::string> sqls = generator.GenerateSqlDelete(msg);
-        if(sqls.empty()) return SQL_GENERATE_EMPTY;
-        my_ulonglong affected = 0;
-        for(int i = 0; i != sqls.size(); ++i) {
-            const std::string& sql = sqls[i];
-            ret = Query(sql.c_str(), sql.length());
-            if(ret) {
-                SetErrorMsg();
-                LOG_WARN << "delete query error: " << LastError() << ", sql: " << sql;
-                return ret;
-            } else {
-                affected += mysql_affected_rows(&mSqlHandler);
+    int index = 0;
+    ret = generator.GenerateSqlDelete(msg, mContext, [this, &index](const std::string& sql) {
+        int queryRet = Query(sql.c_str(), sql.length());
+        ++index;
+        if(queryRet) {
+            SetErrorMsg();
+            mFailedStatement = index - 1;
+            LOG_WARN << "delete query error: " << LastError() << ", sql: " << sql;
+            return queryRet;
+        }
+        mAffectedRows += mysql_affected_rows(&mSqlHandler);
+        return 0;
+    }, mSqlBuffer);
+    if(ret == 0) {
+        LOG_DEBUG << "delete total affect rows: " << mAffectedRows;
+    }
+
+    return ret;
+}
+
+int MysqlInterface::ExecuteMultiStatements(const char* operation, const std::function<int(const std::function<int(const std::string& sql)>& sink)>& generate) {
+    std::size_t first = 0;
+    std::size_t count = 0;
+    const std::size_t limit = mContext.PacketLimit();
+    mBatchSql.clear();
+    int ret = generate([this, &first, &count, limit](const std::string& sql) {
+        if(count != 0 && mBatchSql.length() + 1 + sql.length() > limit) {
+            int queryRet = QueryBatch(first, count);
+            if(queryRet != 0) return queryRet;
+            first += count;
+            count = 0;
+            mBatchSql.clear();
+        }
+        if(count != 0) {
+            mBatchSql += ';';
+        }
+        mBatchSql += sql;
+        ++count;
+        return 0;
+    });
+    if(ret == 0 && count != 0) {
+        ret = QueryBatch(first, count);
+    }
+    if(ret == 0) {
+        LOG_DEBUG << operation << " total affect rows: " << mAffectedRows << ", statements: " << first + count;
+    }
+    return ret;
+}
+
+int MysqlInterface::QueryBatch(std::size_t first, std::size_t count) {
+    const unsigned long threadId = mysql_thread_id(&mSqlHandler);
+    int ret = Query(mBatchSql.c_str(), mBatchSql.length());
+    if(ret != 0 && count > 1 && mAutoCommit && mysql_thread_id(&mSqlHandler) != threadId) {
+        // reconnected by the client library, the new session parsed the batch as one statement and ran nothing
+        mysql_set_server_option(&mSqlHandler, MYSQL_OPTION_MULTI_STATEMENTS_ON);
+        ret = Query(mBatchSql.c_str(), mBatchSql.length());
+    }
+    // one result per statement, the server stops at the first statement that fails
+    for(std::size_t i = 0; i != count; ++i) {
+        if(ret != 0) {
+            ret = mysql_errno(&mSqlHandler);
+            mFailedStatement = static_cast<int>(first + i);
+            SetErrorMsg();
+            LOG_WARN << "statement " << mFailedStatement << " failed: " << LastError();
+            if(mAutoCommit == false) {
+                LOG_WARN << "rollback";
             }
+            return ret;
         }
-        LOG_DEBUG << "delete total affect rows: " << affected;
-    } catch(boost::bad_lexical_cast& e) {
-        LOG_ERROR << "generate delete sql catch exception, what: " << e.what();
-        ret = SQL_GENERATE_FAIL;
+        mAffectedRows += mysql_affected_rows(&mSqlHandler);
+        ret = mysql_next_result(&mSqlHandler);
+        if(ret < 0) break;
     }
+    return 0;
+}
 
+MysqlStatement* MysqlInterface::GetStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask, int& ret) {
+    MysqlStatement* statement = mStatements.Find(&plan, type, mask, generator.Where());
+    if(statement != nullptr) return statement;
+    ret = generator.GenerateStatement(MysqlGenerator::StatementType(type), plan, mask, mSqlBuffer, mStatementColumns);
+    if(ret != 0) return nullptr;
+    std::unique_ptr<MysqlStatement> prepared(new MysqlStatement);
+    ret = prepared->Prepare(&mSqlHandler, plan, mSqlBuffer, mStatementColumns);
+    if(ret != 0) {
+        mErrorStr = prepared->Error();
+        LOG_ERROR << "prepare statement failed: " << mErrorStr << ", sql: " << mSqlBuffer;
+        return nullptr;
+    }
+    return mStatements.Insert(&plan, type, mask, generator.Where(), std::move(prepared));
+}
+
+int MysqlInterface::RunStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask,
+                                 const google::protobuf::Message& row, MysqlStatement*& statement) {
+    int ret = 0;
+    statement = GetStatement(generator, type, plan, mask, ret);
+    if(statement == nullptr) return ret;
+    ret = statement->Execute(row);
+    if(ret == CR_SERVER_GONE_ERROR || ret == CR_SERVER_LOST) {
+        // the statement may have been applied before the connection broke, it is not repeated.
+        // reconnect so the next call prepares its statements on a restored session
+        mErrorStr = statement->Error();
+        LOG_ERROR << "execute statement failed: " << mErrorStr;
+        statement = nullptr;
+        mStatements.Clear();
+        Ping();
+        return ret;
+    }
+    if(ret == CR_NO_PREPARE_STMT || ret == ER_UNKNOWN_STMT_HANDLER) {
+        // the server does not know the statement, it was not run: the connection was reset since it was
+        // prepared. prepare it again on the new session, a lost transaction is not replayed
+        LOG_WARN << "prepared statement lost: " << statement->Error();
+        mStatements.Clear();
+        statement = nullptr;
+        if(mAutoCommit == false) {
+            mErrorStr = "connection lost in transaction";
+            return ret;
+        }
+        if(Ping() == false) return ret;
+        statement = GetStatement(generator, type, plan, mask, ret);
+        if(statement == nullptr) return ret;
+        ret = statement->Execute(row);
+    }
+    if(ret != 0) {
+        mErrorStr = statement->Error();
+        LOG_ERROR << "execute statement failed: " << mErrorStr;
+    }
+    return ret;
+}
+
+int MysqlInterface::ExecuteStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask, const google::protobuf::Message& row) {
+    MysqlStatement* statement = nullptr;
+    int ret = RunStatement(generator, type, plan, mask, row, statement);
+    if(ret != 0) {
+        mFailedStatement = 0;
+        return ret;
+    }
+    mAffectedRows = statement->AffectedRows();
+    LOG_DEBUG << "statement affect rows: " << mAffectedRows;
+    return 0;
+}
+
+int MysqlInterface::ExecuteStatementSelect(const MysqlGenerator& generator, const MysqlPlan& plan, uint64_t mask,
+                                           const google::protobuf::Message& condition, google::protobuf::Message& result, bool multi) {
+    MysqlStatement* statement = nullptr;
+    int ret = RunStatement(generator, MysqlGenerator::STATEMENT_SELECT, plan, mask, condition, statement);
+    if(ret != 0) return ret;
+    ret = statement->StoreResult();
+    if(ret != 0) {
+        mErrorStr = statement->Error();
+        LOG_ERROR << "store statement result failed: " << mErrorStr;
+        return ret;
+    }
+    my_ulonglong rowCount = statement->NumRows();
+    if(rowCount == 0) {
+        ret = ER_KEY_NOT_FOUND;
+    } else if(multi) {
+        result.Clear();
+        const google::protobuf::Reflection* reflection = result.GetReflection();
+        const google::protobuf::FieldDescriptor* field = result.GetDescriptor()->field(0);
+        ReserveRows(result, field, rowCount);
+        for(my_ulonglong i = 0; ret == 0 && i != rowCount; ++i) {
+            ret = statement->Fetch(*reflection->AddMessage(&result, field));
+        }
+    } else {
+        if(rowCount > 1) {
+            LOG_DEBUG << "select result rows: " << rowCount << ", use first one";
+        }
+        ret = statement->Fetch(result);
+    }
+    if(ret == SQL_DECODE_FAIL) {
+        LOG_ERROR << "decode select result failed, message: " << plan.descriptor->full_name();
+    } else if(ret != 0 && ret != ER_KEY_NOT_FOUND) {
+        mErrorStr = statement->Error();
+        LOG_ERROR << "fetch statement result failed: " << mErrorStr;
+    }
+    statement->FreeResult();
     return ret;
 }
@@ -4,6 +4,11 @@
 #include <unistd.h>
 #include <mysql/mysql.h>
 #include <string>
+#include <vector>
+#include <functional>
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+#include <soul/protobuf-mysql/MysqlStatement.h>
+#include <soul/protobuf-mysql/MysqlRowDecoder.h>
 
 namespace google {
     namespace protobuf {
@@ -17,28 +22,94 @@ namespace google {
 
 namespace soul {
     class MysqlGenerator;
+    class MysqlCodec;
+    struct MysqlPlan;
+    struct MysqlSelectMapping;
     class MysqlInterface {
+        public:
+            // receives the rows of a streaming select, a non-zero return stops the select and is passed back
+            typedef std::function<int(google::protobuf::Message& rows)> SelectHandler;
         private:
             MYSQL mSqlHandler;
             bool mAutoCommit;
             std::string mErrorStr;
+            my_ulonglong mAffectedRows;
+            MysqlSqlContext mContext;
+            std::string mSqlBuffer;         // every statement is generated here and sent from here
+            MysqlRowDecoder mDecoder;       // columns of the select result being read
+            bool mPrepared;
+            bool mMultiStatements;
+            int mFailedStatement;
+            std::string mBatchSql;          // statements of one multi statement round trip
+            MysqlStatementCache mStatements;
+            std::vector<int> mStatementColumns;
         public:
             MysqlInterface();
             ~MysqlInterface();
             bool Connect(const char* host, uint16_t port, const char* user, const char* passwd);
+            // one round trip to the server, a lost connection is reconnected and the session state
+            // (autocommit, charset, prepared statements) set up again. return false if the server is unreachable
+            bool Ping();
             void SetAutoCommit(bool on);
+            bool AutoCommit() const { return mAutoCommit; }
+            // single row select, insert, update, upsert and delete run as server side prepared statements bound
+            // from the message fields, one statement per row shape is prepared and kept for the connection.
+            // select rows are decoded from the binary protocol straight into the fields, a repeated message with
+            // one element selects all matching rows the same way. other repeated messages keep the text statements
+            void SetPreparedStatement(bool on);
+            // statements of multi row updates and deletes are joined by ';' into as few packets as max_allowed_packet
+            // allows and their results read back together, one round trip per packet instead of one per statement.
+            // a failed statement stops the ones after it, in autocommit mode as well
+            bool SetMultiStatements(bool on);
+            bool SetCharset(const char* charset);
             bool Commit();
             bool Rollback();
             int SwitchDB(const char* db);
             const std::string LastError() const;
+            // error code of the last call on the connection, text queries themselves only return non-zero
+            unsigned int LastErrno() { return mysql_errno(&mSqlHandler); }
+            // rows changed by the last insert, update, upsert or delete, summed over its statements
+            my_ulonglong AffectedRows() const { return mAffectedRows; }
+            // index of the first failed statement of the last update or delete, -1 if none failed
+            int FailedStatement() const { return mFailedStatement; }
+            // escape mode and max packet size statements for this connection are generated with
+            const MysqlSqlContext& Context() const { return mContext; }
+            // a repeated result gets its pointer array reserved for all rows and every row is created where result
+            // lives: create result with Arena::CreateMessage and the rows are allocated in the blocks of that arena,
+            // freed all at once with it instead of one by one
             int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result);
+            // multi key select, mapping tells which element requested each row and which keys found nothing
+            int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, MysqlSelectMapping& mapping);
+            // streaming select: rows are read from the server one at a time with mysql_use_result (or an unbuffered
+            // prepared statement) instead of being buffered all at once. with a repeated result the rows are added to
+            // its repeated field and handler gets result whenever batchSize rows are collected, then the rows are
+            // cleared for the next batch. with a single row result every row is decoded into result and handed over.
+            // handler must not run other statements on this interface while the select is being read.
+            // return 0, ER_KEY_NOT_FOUND if no row matches or the first error / non-zero handler result
+            int ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, int batchSize, const SelectHandler& handler);
             int ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg);
             int ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg);
             int ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg);
             int ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg);
         private:
             int Query(const char* query, uint64_t len);
+            int ExecuteMultiStatements(const char* operation, const std::function<int(const std::function<int(const std::string& sql)>& sink)>& generate);
+            int QueryBatch(std::size_t first, std::size_t count);
             const std::string& SetErrorMsg();
+            void UpdateEscapeMode();
+            void UpdateMaxPacketSize();
+            int ExecuteStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask, const google::protobuf::Message& row);
+            int ExecuteStatementSelect(const MysqlGenerator& generator, const MysqlPlan& plan, uint64_t mask,
+                                       const google::protobuf::Message& condition, google::protobuf::Message& result, bool multi);
+            const MysqlPlan* GetSelectShape(const MysqlGenerator& generator, const google::protobuf::Message& result,
+                                            uint64_t& mask, const google::protobuf::Message*& condition, bool& multi);
+            static int StreamRows(google::protobuf::Message& result, bool multi, int batchSize, const SelectHandler& handler,
+                                  const std::function<int(google::protobuf::Message& row)>& fetch);
+            int RunStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask,
+                             const google::protobuf::Message& row, MysqlStatement*& statement);
+            MysqlStatement* GetStatement(const MysqlGenerator& generator, int type, const MysqlPlan& plan, uint64_t mask, int& ret);
+            static void ReserveRows(google::protobuf::Message& result, const google::protobuf::FieldDescriptor* field, my_ulonglong rowCount);
+            static int ApplyRow(const MysqlRowDecoder& decoder, MYSQL_ROW row, unsigned long* lengths, google::protobuf::Message& result);
     };
 }
 #endif /*MYSQLINTERFACE_H*/
@@ -0,0 +1,159 @@
+#include <soul/protobuf-mysql/MysqlPlan.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlDescriptor.pb.h>
+#include <google/protobuf/descriptor.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace soul;
+
+namespace {
+    std::size_t EstimateWidth(const google::protobuf::FieldDescriptor* field) {
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                return 1;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                return 10;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                return 11;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                return 16;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                return 20;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                return 24;
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                return 34;
+            default:
+                return 66;
+        }
+    }
+
+    struct PlanKey {
+        const google::protobuf::Descriptor* descriptor;
+        const MysqlTarget* target;
+        bool operator==(const PlanKey& other) const {
+            return descriptor == other.descriptor && target == other.target;
+        }
+    };
+
+    struct PlanKeyHash {
+        std::size_t operator()(const PlanKey& key) const {
+            std::size_t h = std::hash<const void*>()(key.descriptor);
+            return h ^ (std::hash<const void*>()(key.target) + 0x9e3779b9 + (h << 6) + (h >> 2));
+        }
+    };
+
+    class PlanStore {
+        public:
+            std::mutex mMutex;
+            std::unordered_map<std::string, std::unique_ptr<MysqlTarget>> mTargets;
+            std::unordered_map<PlanKey, std::unique_ptr<MysqlPlan>, PlanKeyHash> mPlans;
+
+            static PlanStore& Instance() {
+                static PlanStore store;
+                return store;
+            }
+
+            const MysqlPlan* FindOrBuild(const google::protobuf::Descriptor* descriptor, const MysqlTarget* target) {
+                PlanKey key = {descriptor, target};
+                auto it = mPlans.find(key);
+                if(it != mPlans.end()) {
+                    return it->second.get();
+                }
+
+                std::unique_ptr<MysqlPlan> plan(new MysqlPlan);
+                plan->descriptor = descriptor;
+                plan->target = target;
+                plan->hasRepeated = false;
+                plan->hasUpdateKey = false;
+                plan->rowWidth = 0;
+                plan->codecGeneration = MysqlCodec::Generation();
+                plan->codec = &MysqlCodec::Get(descriptor);
+                plan->reflection = &MysqlCodec::GetReflectionCodec(descriptor);
+                plan->element = nullptr;
+                plan->columns.reserve(descriptor->field_count());
+                for(int i = 0; i != descriptor->field_count(); ++i) {
+                    const google::protobuf::FieldDescriptor* field = descriptor->field(i);
+                    MysqlColumn column;
+                    column.field = field;
+                    column.name = field->name();
+                    column.primaryKey = field->options().GetExtension(primarykey);
+                    column.updateKey = field->options().GetExtension(updatekey);
+                    column.width = EstimateWidth(field);
+                    plan->hasRepeated = plan->hasRepeated || field->is_repeated();
+                    plan->hasUpdateKey = plan->hasUpdateKey || column.updateKey;
+                    plan->rowWidth += column.name.length() + column.width + 5;
+                    if(i != 0) {
+                        plan->allColumns += ", ";
+                    }
+                    plan->allColumns += column.name;
+                    plan->columns.push_back(column);
+                }
+                plan->selectAll = "select " + plan->allColumns + target->selectFrom;
+                plan->insertAll = target->insertInto + plan->allColumns + ") values ";
+
+                const MysqlPlan* result = plan.get();
+                mPlans[key] = std::move(plan);
+                if(descriptor->field_count() == 1 && descriptor->field(0)->is_repeated()
+                        && descriptor->field(0)->type() == google::protobuf::FieldDescriptor::TYPE_MESSAGE) {
+                    const_cast<MysqlPlan*>(result)->element = FindOrBuild(descriptor->field(0)->message_type(), target);
+                }
+                return result;
+            }
+    };
+}
+
+const MysqlTarget* MysqlPlanCache::GetTarget(const std::string& database, const std::string& table) {
+    std::string key = database;
+    key += '\0';
+    key += table;
+
+    static thread_local std::unordered_map<std::string, const MysqlTarget*> cache;
+    auto it = cache.find(key);
+    if(it != cache.end()) {
+        return it->second;
+    }
+    PlanStore& store = PlanStore::Instance();
+    std::lock_guard<std::mutex> lock(store.mMutex);
+    std::unique_ptr<MysqlTarget>& target = store.mTargets[key];
+    if(!target) {
+        target.reset(new MysqlTarget);
+        target->database = database;
+        target->table = table;
+        const std::string qualified = database + "." + table;
+        target->selectFrom = " from " + qualified;
+        target->insertInto = "insert into " + qualified + " (";
+        target->updateSet = "update " + qualified + " set ";
+        target->deleteFrom = "delete from " + qualified;
+    }
+    cache.emplace(std::move(key), target.get());
+    return target.get();
+}
+
+const MysqlPlan* MysqlPlanCache::GetPlan(const google::protobuf::Descriptor* descriptor, const MysqlTarget* target) {
+    PlanKey key = {descriptor, target};
+    static thread_local std::unordered_map<PlanKey, const MysqlPlan*, PlanKeyHash> cache;
+    auto it = cache.find(key);
+    if(it != cache.end()) {
+        return it->second;
+    }
+    PlanStore& store = PlanStore::Instance();
+    std::lock_guard<std::mutex> lock(store.mMutex);
+    const MysqlPlan* plan = store.FindOrBuild(descriptor, target);
+    cache.emplace(key, plan);
+    return plan;
+}
+
+const MysqlCodec& MysqlPlanCache::GetCodec(const MysqlPlan& plan) {
+    const unsigned int generation = MysqlCodec::Generation();
+    if(plan.codecGeneration.load() != generation) {
+        // the generation is read before the lookup, a registration racing with it resolves once more
+        plan.codec = &MysqlCodec::Get(plan.descriptor);
+        plan.codecGeneration = generation;
+    }
+    return *plan.codec.load();
+}
@@ -0,0 +1,68 @@
+#ifndef MYSQLPLAN_H
+#define MYSQLPLAN_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <atomic>
+
+namespace google {
+    namespace protobuf {
+        class Descriptor;
+        class FieldDescriptor;
+    }
+}
+
+namespace soul {
+    class MysqlCodec;
+
+    // sql fragments of one (database, table) pair, built once and shared by all generators.
+    // the where condition stays with the generator, it usually holds literal values
+    struct MysqlTarget {
+        std::string database;
+        std::string table;
+        std::string selectFrom;     // " from database.table"
+        std::string insertInto;     // "insert into database.table ("
+        std::string updateSet;      // "update database.table set "
+        std::string deleteFrom;     // "delete from database.table"
+    };
+
+    struct MysqlColumn {
+        const google::protobuf::FieldDescriptor* field;
+        std::string name;
+        bool primaryKey;
+        bool updateKey;
+        std::size_t width;          // estimated length of a formatted value
+    };
+
+    // everything the generator needs to know about a message type, computed once per (descriptor, target)
+    struct MysqlPlan {
+        const google::protobuf::Descriptor* descriptor;
+        const MysqlTarget* target;
+        std::vector<MysqlColumn> columns;
+        bool hasRepeated;
+        bool hasUpdateKey;
+        std::size_t rowWidth;       // estimated length of "col = value" for all columns
+        // generated codec if registered, otherwise same as reflection. resolved again when a codec registers
+        // later, e.g. a plan built during static initialization before the generated registrar ran
+        mutable std::atomic<const MysqlCodec*> codec;
+        mutable std::atomic<unsigned int> codecGeneration;
+        const MysqlCodec* reflection;
+        const MysqlPlan* element;   // plan of the element type if message only holds one repeated message field
+        std::string allColumns;     // "col1, col2, ..."
+        std::string selectAll;      // "select col1, col2, ... from database.table"
+        std::string insertAll;      // "insert into database.table (col1, col2, ...) values "
+    };
+
+    // targets and plans live as long as the process. every thread looks them up in its own cache first,
+    // the shared store and its lock are only reached the first time a thread needs one
+    class MysqlPlanCache {
+        public:
+            static const MysqlTarget* GetTarget(const std::string& database, const std::string& table);
+            static const MysqlPlan* GetPlan(const google::protobuf::Descriptor* descriptor, const MysqlTarget* target);
+            // plan.codec, looked up again if a codec was registered since it was last resolved
+            static const MysqlCodec& GetCodec(const MysqlPlan& plan);
+    };
+}
+
+#endif /*MYSQLPLAN_H*/
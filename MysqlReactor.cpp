@@ -0,0 +1,566 @@
+#include <soul/protobuf-mysql/MysqlReactor.h>
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlError.h>
+#include <soul/Log.h>
+#include <mysql/errmsg.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+
+using namespace soul;
+
+namespace {
+    // a connection that failed or was lost is opened again after this
+    const int kRetryInterval = 1000;
+    const int kMaxEvents = 64;
+
+#ifdef MYSQL_WAIT_READ
+    const bool kNonBlockingApi = true;
+
+    // MariaDB Connector/C non-blocking api: *_start begins a call and returns the MYSQL_WAIT_* events it waits
+    // for, *_cont resumes it with the events that happened, 0 means the call completed and set its result
+    int ConnectStart(MYSQL*& connected, MYSQL* handle, const MysqlPoolConfig& config) {
+        mysql_options(handle, MYSQL_OPT_NONBLOCK, 0);
+        if(!config.charset.empty()) {
+            mysql_options(handle, MYSQL_SET_CHARSET_NAME, config.charset.c_str());
+        }
+        return mysql_real_connect_start(&connected, handle, config.host.c_str(), config.user.c_str(), config.passwd.c_str(),
+                                        config.database.empty() ? nullptr : config.database.c_str(), config.port, nullptr, 0);
+    }
+
+    int ConnectCont(MYSQL*& connected, MYSQL* handle, int events) {
+        return mysql_real_connect_cont(&connected, handle, events);
+    }
+
+    int QueryStart(int& error, MYSQL* handle, const std::string& sql) {
+        return mysql_real_query_start(&error, handle, sql.data(), sql.length());
+    }
+
+    int QueryCont(int& error, MYSQL* handle, int events) {
+        return mysql_real_query_cont(&error, handle, events);
+    }
+
+    int StoreStart(MYSQL_RES*& res, MYSQL* handle) {
+        return mysql_store_result_start(&res, handle);
+    }
+
+    int StoreCont(MYSQL_RES*& res, MYSQL* handle, int events) {
+        return mysql_store_result_cont(&res, handle, events);
+    }
+
+    int Socket(MYSQL* handle) {
+        return mysql_get_socket(handle);
+    }
+
+    int TimeoutMs(MYSQL* handle) {
+        return mysql_get_timeout_value_ms(handle);
+    }
+#else
+    const bool kNonBlockingApi = false;
+    enum { MYSQL_WAIT_READ = 1, MYSQL_WAIT_WRITE = 2, MYSQL_WAIT_EXCEPT = 4, MYSQL_WAIT_TIMEOUT = 8 };
+
+    int ConnectStart(MYSQL*& connected, MYSQL*, const MysqlPoolConfig&) {
+        connected = nullptr;
+        return 0;
+    }
+
+    int ConnectCont(MYSQL*& connected, MYSQL*, int) {
+        connected = nullptr;
+        return 0;
+    }
+
+    int QueryStart(int& error, MYSQL*, const std::string&) {
+        error = CR_SERVER_GONE_ERROR;
+        return 0;
+    }
+
+    int QueryCont(int& error, MYSQL*, int) {
+        error = CR_SERVER_GONE_ERROR;
+        return 0;
+    }
+
+    int StoreStart(MYSQL_RES*& res, MYSQL*) {
+        res = nullptr;
+        return 0;
+    }
+
+    int StoreCont(MYSQL_RES*& res, MYSQL*, int) {
+        res = nullptr;
+        return 0;
+    }
+
+    int Socket(MYSQL*) {
+        return -1;
+    }
+
+    int TimeoutMs(MYSQL*) {
+        return 0;
+    }
+#endif
+}
+
+MysqlReactor::MysqlReactor() : mEpoll(epoll_create1(EPOLL_CLOEXEC)), mWakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), mStopped(false) {
+    if(mEpoll < 0 || mWakeup < 0) {
+        LOG_ERROR << "create epoll or eventfd failed";
+        return;
+    }
+    epoll_event event = epoll_event();
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(mEpoll, EPOLL_CTL_ADD, mWakeup, &event);
+}
+
+MysqlReactor::~MysqlReactor() {
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        Connection& connection = *mConnections[i];
+        if(connection.operation) {
+            Fail(std::move(connection.operation), SQL_NO_CONNECTION);
+        }
+        if(connection.state != STATE_CLOSED) {
+            Close(connection);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(std::size_t i = 0; i != mSubmitted.size(); ++i) {
+            mPending.push_back(std::move(mSubmitted[i]));
+        }
+        mSubmitted.clear();
+    }
+    while(!mPending.empty()) {
+        std::unique_ptr<Operation> operation = std::move(mPending.front());
+        mPending.pop_front();
+        Fail(std::move(operation), SQL_NO_CONNECTION);
+    }
+    if(mWakeup >= 0) {
+        close(mWakeup);
+    }
+    if(mEpoll >= 0) {
+        close(mEpoll);
+    }
+}
+
+std::size_t MysqlReactor::Start(const MysqlPoolConfig& config) {
+    mConfig = config;
+    if(mConfig.size == 0) {
+        mConfig.size = 1;
+    }
+    if(!kNonBlockingApi) {
+        // no connection is created or retried, operations fail with SQL_NO_CONNECTION
+        LOG_ERROR << "mysql client library has no non-blocking api, MysqlReactor needs MariaDB Connector/C";
+        return 0;
+    }
+    mysql_library_init(0, nullptr, nullptr);
+
+    // statements are generated on the submitting threads: max packet size and escape mode are read once
+    // on a blocking connection, which is kept only if the charset needs the client library to escape
+    mSession.reset(new MysqlInterface());
+    if(mSession->Connect(mConfig.host.c_str(), mConfig.port, mConfig.user.c_str(), mConfig.passwd.c_str())
+            && (mConfig.charset.empty() || mSession->SetCharset(mConfig.charset.c_str()))) {
+        mContext = mSession->Context();
+    }
+    if(mContext.escapeConnection == nullptr) {
+        mSession.reset();
+    }
+
+    for(std::size_t i = 0; i != mConfig.size; ++i) {
+        mConnections.emplace_back(new Connection());
+        Connection& connection = *mConnections.back();
+        connection.fd = -1;
+        connection.state = STATE_CLOSED;
+        connection.wait = 0;
+        connection.connected = nullptr;
+        connection.queryError = 0;
+        connection.res = nullptr;
+        Open(connection);
+    }
+    while(true) {
+        bool connecting = false;
+        for(std::size_t i = 0; i != mConnections.size(); ++i) {
+            connecting = connecting || mConnections[i]->state == STATE_CONNECTING;
+        }
+        if(!connecting) break;
+        Poll(kRetryInterval);
+    }
+    std::size_t connected = 0;
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        if(mConnections[i]->state == STATE_READY) {
+            ++connected;
+        }
+    }
+    LOG_DEBUG << "mysql reactor started, " << connected << " of " << mConnections.size() << " connected";
+    return connected;
+}
+
+void MysqlReactor::Run() {
+    while(!mStopped) {
+        Poll(-1);
+    }
+}
+
+void MysqlReactor::Stop() {
+    mStopped = true;
+    uint64_t one = 1;
+    if(write(mWakeup, &one, sizeof(one)) < 0) {
+        LOG_WARN << "wake up mysql reactor failed";
+    }
+}
+
+void MysqlReactor::Poll(int timeout) {
+    Dispatch();
+    epoll_event events[kMaxEvents];
+    int count = epoll_wait(mEpoll, events, kMaxEvents, NextTimeout(timeout));
+    for(int i = 0; i < count; ++i) {
+        if(events[i].data.ptr == nullptr) {
+            uint64_t value;
+            while(read(mWakeup, &value, sizeof(value)) > 0) {}
+            continue;
+        }
+        Connection& connection = *static_cast<Connection*>(events[i].data.ptr);
+        int wait = 0;
+        if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) wait |= MYSQL_WAIT_READ;
+        if(events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) wait |= MYSQL_WAIT_WRITE;
+        if(events[i].events & EPOLLPRI) wait |= MYSQL_WAIT_EXCEPT;
+        Continue(connection, wait);
+    }
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        Connection& connection = *mConnections[i];
+        if(connection.deadline > now) continue;
+        if(connection.state == STATE_CLOSED) {
+            Open(connection);
+        } else if(connection.wait & MYSQL_WAIT_TIMEOUT) {
+            Continue(connection, MYSQL_WAIT_TIMEOUT);
+        }
+    }
+    Dispatch();
+    ExpirePending();
+}
+
+void MysqlReactor::ExpirePending() {
+    // queued in submit order, so the first one expires first
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while(!mPending.empty() && mPending.front()->expire <= now) {
+        std::unique_ptr<Operation> operation = std::move(mPending.front());
+        mPending.pop_front();
+        LOG_WARN << "no mysql connection for a queued operation after " << mConfig.acquireTimeout << " ms";
+        Fail(std::move(operation), SQL_NO_CONNECTION);
+    }
+}
+
+int MysqlReactor::NextTimeout(int timeout) const {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    if(!mPending.empty()) {
+        deadline = mPending.front()->expire;
+    }
+    for(std::size_t i = 0; i != mConnections.size(); ++i) {
+        const Connection& connection = *mConnections[i];
+        if(connection.state == STATE_CLOSED || (connection.wait & MYSQL_WAIT_TIMEOUT) != 0) {
+            deadline = std::min(deadline, connection.deadline);
+        }
+    }
+    if(deadline == std::chrono::steady_clock::time_point::max()) return timeout;
+    long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count() + 1;
+    left = std::max(left, 0LL);
+    return timeout >= 0 && timeout < left ? timeout : static_cast<int>(left);
+}
+
+std::unique_ptr<MysqlReactor::Operation> MysqlReactor::NewOperation(OperationType type, const Callback& callback) const {
+    std::unique_ptr<Operation> operation(new Operation());
+    operation->type = type;
+    operation->next = 0;
+    operation->result = nullptr;
+    operation->row = nullptr;
+    operation->codec = nullptr;
+    operation->multi = false;
+    operation->callback = callback;
+    operation->expire = mConfig.acquireTimeout < 0 ? std::chrono::steady_clock::time_point::max()
+        : std::chrono::steady_clock::now() + std::chrono::milliseconds(mConfig.acquireTimeout);
+    return operation;
+}
+
+void MysqlReactor::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_SELECT, callback);
+    operation->statements.resize(1);
+    if(generator.GenerateSqlSelect(result, mContext, operation->statements[0]) != 0) {
+        operation->statements.clear();
+        operation->outcome.error = SQL_GENERATE_EMPTY;
+    }
+    operation->result = &result;
+    operation->multi = MysqlGenerator::OnlyHoldsOneRepeatedMessageField(result);
+    operation->row = operation->multi ? result.GetDescriptor()->field(0)->message_type() : result.GetDescriptor();
+    operation->codec = &generator.GetCodec(operation->row);
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_WRITE, callback);
+    std::vector<std::string>& statements = operation->statements;
+    operation->outcome.error = generator.GenerateSqlInsert(msg, mContext, [&statements](const std::string& sql) {
+        statements.push_back(sql);
+        return 0;
+    });
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_UPDATE, callback);
+    std::vector<std::string>& statements = operation->statements;
+    operation->outcome.error = generator.GenerateSqlUpdate(msg, mContext, [&statements](const std::string& sql) {
+        statements.push_back(sql);
+        return 0;
+    });
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_WRITE, callback);
+    std::vector<std::string>& statements = operation->statements;
+    operation->outcome.error = generator.GenerateSqlUpdateOnInsert(msg, mContext, [&statements](const std::string& sql) {
+        statements.push_back(sql);
+        return 0;
+    });
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_WRITE, callback);
+    std::vector<std::string>& statements = operation->statements;
+    operation->outcome.error = generator.GenerateSqlDelete(msg, mContext, [&statements](const std::string& sql) {
+        statements.push_back(sql);
+        return 0;
+    });
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::Commit(const Callback& callback) {
+    Submit(NewOperation(OPERATION_NONE, callback));
+}
+
+void MysqlReactor::Rollback(const Callback& callback) {
+    std::unique_ptr<Operation> operation = NewOperation(OPERATION_NONE, callback);
+    operation->outcome.error = SQL_NO_TRANSACTION;
+    Submit(std::move(operation));
+}
+
+void MysqlReactor::Submit(std::unique_ptr<Operation> operation) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mSubmitted.push_back(std::move(operation));
+    }
+    uint64_t one = 1;
+    if(write(mWakeup, &one, sizeof(one)) < 0) {
+        LOG_WARN << "wake up mysql reactor failed";
+    }
+}
+
+void MysqlReactor::Fail(std::unique_ptr<Operation> operation, int error) {
+    operation->outcome.error = error;
+    operation->outcome.statement = operation->next;
+    if(operation->callback) {
+        operation->callback(operation->outcome);
+    }
+}
+
+void MysqlReactor::Open(Connection& connection) {
+    mysql_init(&connection.handle);
+    connection.state = STATE_CONNECTING;
+    connection.connected = nullptr;
+    Advance(connection, ConnectStart(connection.connected, &connection.handle, mConfig));
+}
+
+void MysqlReactor::Close(Connection& connection) {
+    if(connection.fd >= 0) {
+        epoll_ctl(mEpoll, EPOLL_CTL_DEL, connection.fd, nullptr);
+        connection.fd = -1;
+    }
+    if(connection.res != nullptr) {
+        mysql_free_result(connection.res);
+        connection.res = nullptr;
+    }
+    mysql_close(&connection.handle);
+    connection.state = STATE_CLOSED;
+    connection.wait = 0;
+    connection.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRetryInterval);
+}
+
+void MysqlReactor::Dispatch() {
+    std::deque<std::unique_ptr<Operation>> submitted;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        submitted.swap(mSubmitted);
+    }
+    for(std::size_t i = 0; i != submitted.size(); ++i) {
+        if(submitted[i]->statements.empty()) {
+            // nothing to send, completes with its preset result without a round trip
+            const int error = submitted[i]->outcome.error;
+            Fail(std::move(submitted[i]), error);
+        } else if(mConnections.empty()) {
+            Fail(std::move(submitted[i]), SQL_NO_CONNECTION);
+        } else {
+            mPending.push_back(std::move(submitted[i]));
+        }
+    }
+    for(std::size_t i = 0; i != mConnections.size() && !mPending.empty(); ++i) {
+        Connection& connection = *mConnections[i];
+        if(connection.state != STATE_READY || connection.operation) continue;
+        connection.operation = std::move(mPending.front());
+        mPending.pop_front();
+        Begin(connection);
+    }
+}
+
+void MysqlReactor::Begin(Connection& connection) {
+    Operation& operation = *connection.operation;
+    operation.outcome = MysqlAsyncResult();
+    operation.next = 0;
+    connection.state = STATE_QUERY;
+    Advance(connection, QueryStart(connection.queryError, &connection.handle, operation.statements[0]));
+}
+
+void MysqlReactor::Continue(Connection& connection, int events) {
+    int status = 0;
+    switch (connection.state) {
+        case STATE_CONNECTING:
+            status = ConnectCont(connection.connected, &connection.handle, events);
+            break;
+        case STATE_QUERY:
+            status = QueryCont(connection.queryError, &connection.handle, events);
+            break;
+        case STATE_STORE:
+            status = StoreCont(connection.res, &connection.handle, events);
+            break;
+        case STATE_READY:
+            // an idle connection is only readable once the server closed it, e.g. after wait_timeout
+            LOG_WARN << "idle mysql connection closed by server";
+            Close(connection);
+            return;
+        default:
+            return;
+    }
+    Advance(connection, status);
+}
+
+void MysqlReactor::Advance(Connection& connection, int status) {
+    while(status == 0) {
+        if(connection.state == STATE_CONNECTING) {
+            if(connection.connected == nullptr) {
+                LOG_ERROR << "mysql connect failed: " << mysql_error(&connection.handle);
+                Close(connection);
+                return;
+            }
+            connection.state = STATE_READY;
+            break;
+        }
+        Operation& operation = *connection.operation;
+        if(connection.state == STATE_QUERY) {
+            if(connection.queryError != 0) {
+                operation.outcome.error = mysql_errno(&connection.handle);
+                operation.outcome.statement = operation.next;
+                operation.outcome.errorStr = mysql_error(&connection.handle);
+                LOG_ERROR << operation.outcome.errorStr << ", sql: " << operation.statements[operation.next];
+                if(operation.type != OPERATION_UPDATE || operation.outcome.error == CR_SERVER_GONE_ERROR
+                        || operation.outcome.error == CR_SERVER_LOST) {
+                    Finish(connection);
+                    return;
+                }
+            } else if(mysql_field_count(&connection.handle) != 0) {
+                connection.state = STATE_STORE;
+                status = StoreStart(connection.res, &connection.handle);
+                continue;
+            } else {
+                operation.outcome.affectedRows += mysql_affected_rows(&connection.handle);
+            }
+        } else if(connection.state == STATE_STORE) {
+            if(connection.res == nullptr) {
+                operation.outcome.error = mysql_errno(&connection.handle);
+                operation.outcome.statement = operation.next;
+                operation.outcome.errorStr = mysql_error(&connection.handle);
+                Finish(connection);
+                return;
+            }
+            DecodeResult(connection);
+            mysql_free_result(connection.res);
+            connection.res = nullptr;
+        }
+        if(++operation.next == operation.statements.size()) {
+            Finish(connection);
+            return;
+        }
+        connection.state = STATE_QUERY;
+        status = QueryStart(connection.queryError, &connection.handle, operation.statements[operation.next]);
+    }
+    Watch(connection, status);
+}
+
+void MysqlReactor::Finish(Connection& connection) {
+    std::unique_ptr<Operation> operation = std::move(connection.operation);
+    connection.state = STATE_READY;
+    const int error = operation->outcome.error;
+    if(error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+        // reopened by the loop, the failed operation is not repeated because it may have been applied
+        Close(connection);
+    } else {
+        Watch(connection, 0);
+    }
+    if(operation->callback) {
+        operation->callback(operation->outcome);
+    }
+}
+
+void MysqlReactor::Watch(Connection& connection, int status) {
+    connection.wait = status;
+    if(status & MYSQL_WAIT_TIMEOUT) {
+        connection.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TimeoutMs(&connection.handle));
+    }
+    epoll_event event = epoll_event();
+    if(status & MYSQL_WAIT_READ) event.events |= EPOLLIN;
+    if(status & MYSQL_WAIT_WRITE) event.events |= EPOLLOUT;
+    if(status & MYSQL_WAIT_EXCEPT) event.events |= EPOLLPRI;
+    if(connection.state == STATE_READY) {
+        // nothing is expected while idle, watch for the server closing the connection
+        event.events = EPOLLIN | EPOLLRDHUP;
+    }
+    event.data.ptr = &connection;
+    if(connection.fd < 0) {
+        connection.fd = Socket(&connection.handle);
+        if(connection.fd < 0) return;
+        epoll_ctl(mEpoll, EPOLL_CTL_ADD, connection.fd, &event);
+    } else {
+        epoll_ctl(mEpoll, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+}
+
+void MysqlReactor::DecodeResult(Connection& connection) {
+    Operation& operation = *connection.operation;
+    MYSQL_RES* res = connection.res;
+    google::protobuf::Message& result = *operation.result;
+    my_ulonglong rowCount = mysql_num_rows(res);
+    if(rowCount == 0) {
+        operation.outcome.error = ER_KEY_NOT_FOUND;
+        return;
+    }
+    mDecoder.Reset(*operation.codec, operation.row, mysql_fetch_fields(res), mysql_num_fields(res));
+    MysqlDecodeStatus status;
+    MYSQL_ROW row;
+    if(operation.multi) {
+        result.Clear();
+        const google::protobuf::Reflection* reflection = result.GetReflection();
+        const google::protobuf::FieldDescriptor* field = result.GetDescriptor()->field(0);
+        reflection->MutableRepeatedPtrField<google::protobuf::Message>(&result, field)->Reserve(static_cast<int>(rowCount));
+        while(status.error == 0 && (row = mysql_fetch_row(res)) != nullptr) {
+            mDecoder.Decode(row, mysql_fetch_lengths(res), *reflection->AddMessage(&result, field), status);
+        }
+    } else if((row = mysql_fetch_row(res)) != nullptr) {
+        mDecoder.Decode(row, mysql_fetch_lengths(res), result, status);
+    }
+    if(status.error != 0) {
+        LOG_ERROR << "decode select result failed, message: " << operation.row->full_name()
+                  << ", field: " << operation.row->field(status.field)->name();
+        operation.outcome.error = status.error;
+    }
+}
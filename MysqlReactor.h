@@ -0,0 +1,118 @@
+#ifndef MYSQLREACTOR_H
+#define MYSQLREACTOR_H
+
+#include <mysql/mysql.h>
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+#include <soul/protobuf-mysql/MysqlRowDecoder.h>
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <soul/protobuf-mysql/MysqlAsyncExecutor.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class Descriptor;
+    }
+}
+
+namespace soul {
+    class MysqlGenerator;
+
+    // one epoll loop driving many connections with the non-blocking api of MariaDB Connector/C
+    // (mysql_real_query_start / _cont). operations queue up and go to whichever connection is free, every connection
+    // runs one operation at a time so the number of connections is the number of operations in flight.
+    // the loop runs in the thread calling Run, operations can be submitted from any thread and complete with
+    // their callback on the loop thread. connections run in autocommit mode, transactions need MysqlInterface.
+    // built against libmysqlclient without that api Start connects nothing and every operation fails with SQL_NO_CONNECTION
+    class MysqlReactor : public MysqlAsyncExecutor {
+        private:
+            enum OperationType { OPERATION_NONE, OPERATION_SELECT, OPERATION_WRITE, OPERATION_UPDATE };
+            struct Operation {
+                OperationType type;
+                std::vector<std::string> statements;
+                std::size_t next;
+                google::protobuf::Message* result;          // select only, written on the loop thread
+                const google::protobuf::Descriptor* row;
+                const MysqlCodec* codec;
+                bool multi;
+                Callback callback;
+                MysqlAsyncResult outcome;
+                std::chrono::steady_clock::time_point expire;   // fails with SQL_NO_CONNECTION if still queued then
+            };
+            enum State { STATE_CLOSED, STATE_CONNECTING, STATE_READY, STATE_QUERY, STATE_STORE };
+            struct Connection {
+                MYSQL handle;
+                int fd;
+                State state;
+                int wait;                                   // MYSQL_WAIT_* the api is waiting for
+                std::chrono::steady_clock::time_point deadline;
+                std::unique_ptr<Operation> operation;
+                MYSQL* connected;
+                int queryError;
+                MYSQL_RES* res;
+            };
+
+            MysqlPoolConfig mConfig;
+            std::unique_ptr<MysqlInterface> mSession;      // blocking connection the escaping of unsafe charsets runs on
+            MysqlSqlContext mContext;
+            int mEpoll;
+            int mWakeup;                                    // eventfd, wakes the loop on submit and stop
+            std::atomic<bool> mStopped;
+            std::vector<std::unique_ptr<Connection>> mConnections;
+            std::mutex mMutex;
+            std::deque<std::unique_ptr<Operation>> mSubmitted;
+            std::deque<std::unique_ptr<Operation>> mPending;
+            MysqlRowDecoder mDecoder;
+        public:
+            MysqlReactor();
+            // operations still queued complete with SQL_NO_CONNECTION
+            ~MysqlReactor();
+            MysqlReactor(const MysqlReactor&) = delete;
+            MysqlReactor& operator=(const MysqlReactor&) = delete;
+
+            // open config.size connections, all handshakes run concurrently. return the number connected,
+            // the others are retried by the loop. call once before Run and before anything is submitted
+            std::size_t Start(const MysqlPoolConfig& config);
+            // the loop, returns after Stop
+            void Run();
+            // one pass of the loop, waits up to timeout ms (-1 forever) for events
+            void Poll(int timeout);
+            void Stop();
+
+            // the statements are generated in the calling thread, msg can go once the call returns.
+            // result of a select is written on the loop thread and must stay untouched until the callback.
+            // an operation no connection picks up within config.acquireTimeout completes with SQL_NO_CONNECTION
+            virtual void ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, const Callback& callback);
+            virtual void ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            // like MysqlInterface in autocommit mode a failed statement does not stop the others, the last error is reported
+            virtual void ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            // every statement is committed on its own, Commit completes at once and Rollback with SQL_NO_TRANSACTION
+            virtual void Commit(const Callback& callback);
+            virtual void Rollback(const Callback& callback);
+        private:
+            std::unique_ptr<Operation> NewOperation(OperationType type, const Callback& callback) const;
+            void Submit(std::unique_ptr<Operation> operation);
+            void Fail(std::unique_ptr<Operation> operation, int error);
+            void Open(Connection& connection);
+            void Close(Connection& connection);
+            void Dispatch();
+            void Begin(Connection& connection);
+            void Continue(Connection& connection, int events);
+            void Advance(Connection& connection, int status);
+            void Finish(Connection& connection);
+            void Watch(Connection& connection, int status);
+            void DecodeResult(Connection& connection);
+            void ExpirePending();
+            int NextTimeout(int timeout) const;
+    };
+}
+
+#endif /*MYSQLREACTOR_H*/
@@ -0,0 +1,150 @@
+#include <soul/protobuf-mysql/MysqlRowDecoder.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlError.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
+
+using namespace soul;
+
+namespace {
+    typedef MysqlRowDecoder::Column Column;
+
+    bool SetGenerated(const Column& column, const google::protobuf::Reflection*, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        return column.codec->SetColumn(msg, column.field, data, length);
+    }
+
+    bool SetInt32(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        int32_t value;
+        if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+        reflection->SetInt32(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetInt64(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        int64_t value;
+        if(!MysqlCodec::ParseInt64(data, length, value)) return false;
+        reflection->SetInt64(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetUInt32(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        uint32_t value;
+        if(!MysqlCodec::ParseUInt32(data, length, value)) return false;
+        reflection->SetUInt32(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetUInt64(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        uint64_t value;
+        if(!MysqlCodec::ParseUInt64(data, length, value)) return false;
+        reflection->SetUInt64(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetDouble(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        double value;
+        if(!MysqlCodec::ParseDouble(data, length, value)) return false;
+        reflection->SetDouble(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetFloat(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        float value;
+        if(!MysqlCodec::ParseFloat(data, length, value)) return false;
+        reflection->SetFloat(&msg, column.descriptor, value);
+        return true;
+    }
+
+    bool SetBool(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        int32_t value;
+        if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+        reflection->SetBool(&msg, column.descriptor, value != 0);
+        return true;
+    }
+
+    bool SetEnum(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        int32_t value;
+        if(!MysqlCodec::ParseInt32(data, length, value)) return false;
+        const google::protobuf::EnumValueDescriptor* enumValue = column.descriptor->enum_type()->FindValueByNumber(value);
+        if(enumValue == nullptr) return false;
+        reflection->SetEnum(&msg, column.descriptor, enumValue);
+        return true;
+    }
+
+    bool SetString(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        reflection->SetString(&msg, column.descriptor, std::string(data, length));
+        return true;
+    }
+
+    bool SetMessage(const Column& column, const google::protobuf::Reflection* reflection, google::protobuf::Message& msg, const char* data, unsigned long length) {
+        return reflection->MutableMessage(&msg, column.descriptor)->ParseFromArray(data, length);
+    }
+
+    MysqlRowDecoder::Setter GetSetter(const google::protobuf::FieldDescriptor* field) {
+        if(field->is_repeated()) return nullptr;
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                return SetInt32;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                return SetInt64;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                return SetUInt32;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                return SetUInt64;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                return SetDouble;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                return SetFloat;
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                return SetBool;
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                return SetEnum;
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                return SetString;
+            case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+                return SetMessage;
+            default:
+                return nullptr;
+        }
+    }
+
+    bool SetNothing(const Column&, const google::protobuf::Reflection*, google::protobuf::Message&, const char*, unsigned long) {
+        return false;
+    }
+}
+
+void MysqlRowDecoder::Reset(const MysqlCodec& codec, const google::protobuf::Descriptor* descriptor, const MYSQL_FIELD* fields, unsigned int fieldCount) {
+    mColumns.clear();
+    const bool generated = MysqlCodec::Find(descriptor) == &codec;
+    for(unsigned int i = 0; i != fieldCount; ++i) {
+        const google::protobuf::FieldDescriptor* field = descriptor->FindFieldByName(fields[i].name);
+        if(field == nullptr) continue;
+        Column column;
+        column.result = i;
+        column.field = field->index();
+        column.descriptor = field;
+        column.codec = &codec;
+        column.setter = generated ? SetGenerated : GetSetter(field);
+        if(column.setter == nullptr) {
+            column.setter = SetNothing;
+        }
+        mColumns.push_back(column);
+    }
+}
+
+int MysqlRowDecoder::Decode(MYSQL_ROW row, const unsigned long* lengths, google::protobuf::Message& msg, MysqlDecodeStatus& status) const {
+    const google::protobuf::Reflection* reflection = msg.GetReflection();
+    for(std::size_t i = 0; i != mColumns.size(); ++i) {
+        const Column& column = mColumns[i];
+        const char* data = row[column.result];
+        if(data == nullptr) continue;
+        if(column.setter(column, reflection, msg, data, lengths[column.result]) == false) {
+            status.error = SQL_DECODE_FAIL;
+            status.column = column.result;
+            status.field = column.field;
+            return status.error;
+        }
+    }
+    status.error = 0;
+    return 0;
+}
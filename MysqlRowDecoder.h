@@ -0,0 +1,54 @@
+#ifndef MYSQLROWDECODER_H
+#define MYSQLROWDECODER_H
+
+#include <mysql/mysql.h>
+#include <vector>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class Descriptor;
+        class FieldDescriptor;
+        class Reflection;
+    }
+}
+
+namespace soul {
+    class MysqlCodec;
+
+    // outcome of decoding one row, error is 0 or SQL_DECODE_FAIL with the column that could not be decoded
+    struct MysqlDecodeStatus {
+        int error;
+        int column;                 // index in the result row
+        int field;                  // field index in the descriptor
+        MysqlDecodeStatus() : error(0), column(-1), field(-1) {}
+    };
+
+    // columns of one text result set resolved to fields once, every row is then decoded through that table
+    // without any name lookup or type dispatch per cell
+    class MysqlRowDecoder {
+        public:
+            struct Column;
+            typedef bool (*Setter)(const Column& column, const google::protobuf::Reflection* reflection,
+                                   google::protobuf::Message& msg, const char* data, unsigned long length);
+            struct Column {
+                int result;                                     // index in the result row
+                int field;                                      // field index in the descriptor
+                const google::protobuf::FieldDescriptor* descriptor;
+                const MysqlCodec* codec;
+                Setter setter;
+            };
+        private:
+            std::vector<Column> mColumns;       // result columns matching a field, in result order
+        public:
+            // resolve the result columns by name against descriptor. generated codecs decode through the codec,
+            // reflection is bound to a setter picked by the field type
+            void Reset(const MysqlCodec& codec, const google::protobuf::Descriptor* descriptor, const MYSQL_FIELD* fields, unsigned int fieldCount);
+            // cells are bounded by lengths, NULL cells leave their field unset. stops at the first cell that
+            // is no valid value of its field, the fields decoded before it stay set
+            int Decode(MYSQL_ROW row, const unsigned long* lengths, google::protobuf::Message& msg, MysqlDecodeStatus& status) const;
+            std::size_t Size() const { return mColumns.size(); }
+    };
+}
+
+#endif /*MYSQLROWDECODER_H*/
@@ -0,0 +1,106 @@
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+#include <google/protobuf/message.h>
+#include <mysql/mysql.h>
+#include <cstring>
+
+using namespace soul;
+
+std::size_t MysqlSqlBuilder::WriteQuoted(std::size_t start, const char* str, std::size_t len) {
+    mBuffer[start] = '\'';
+    std::size_t escaped = 0;
+    if(mEscapeConnection != nullptr) {
+        escaped = mysql_real_escape_string(mEscapeConnection, &mBuffer[start + 1], str, len);
+    } else {
+        escaped = MysqlFormat::EscapeString(str, len, &mBuffer[start + 1]);
+    }
+    mBuffer[start + 1 + escaped] = '\'';
+    return start + escaped + 2;
+}
+
+std::size_t MysqlSqlBuilder::WriteHex(std::size_t start, const char* str, std::size_t len) {
+    mBuffer[start] = 'X';
+    mBuffer[start + 1] = '\'';
+    MysqlFormat::HexEncode(str, len, &mBuffer[start + 2]);
+    mBuffer[start + 2 + len * 2] = '\'';
+    return start + len * 2 + 3;
+}
+
+void MysqlSqlBuilder::AppendQuoted(const char* str, std::size_t len) {
+    const std::size_t start = mBuffer.size();
+    mBuffer.resize(start + len * 2 + 3);
+    mBuffer.resize(WriteQuoted(start, str, len));
+}
+
+void MysqlSqlBuilder::AppendHex(const char* str, std::size_t len) {
+    const std::size_t start = mBuffer.size();
+    mBuffer.resize(start + len * 2 + 3);
+    WriteHex(start, str, len);
+}
+
+bool MysqlSqlBuilder::IsEscapeSafeCharset(const char* charset) {
+    static const char* const unsafe[] = {"big5", "cp932", "gbk", "gb18030", "sjis"};
+    for(std::size_t i = 0; i != sizeof(unsafe) / sizeof(unsafe[0]); ++i) {
+        if(strcmp(charset, unsafe[i]) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MysqlSqlBuilder::AppendMessage(const google::protobuf::Message& msg) {
+    // serialized behind the room the literal needs, which is written in front of it and never reaches it
+    const std::size_t len = msg.ByteSizeLong();
+    const std::size_t start = mBuffer.size();
+    const std::size_t tail = start + len * 2 + 3;
+    mBuffer.resize(tail + len);
+    msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(&mBuffer[tail]));
+    if(mHexMessage) {
+        mBuffer.resize(WriteHex(start, &mBuffer[tail], len));
+    } else {
+        mBuffer.resize(WriteQuoted(start, &mBuffer[tail], len));
+    }
+}
+
+void MysqlSqlBuilder::AppendFieldValue(const google::protobuf::Reflection* reflection,
+                                       const google::protobuf::Message& msg,
+                                       const google::protobuf::FieldDescriptor* field) {
+    if(field->is_repeated()) return;
+    switch (field->cpp_type()) {
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+            AppendInt32(reflection->GetInt32(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+            AppendInt64(reflection->GetInt64(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+            AppendUInt32(reflection->GetUInt32(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+            AppendUInt64(reflection->GetUInt64(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+            AppendDouble(reflection->GetDouble(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+            AppendFloat(reflection->GetFloat(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            mBuffer += reflection->GetBool(msg, field) ? '1' : '0';
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+            AppendInt32(reflection->GetEnumValue(msg, field));
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+            {
+                std::string scratch;
+                const std::string& value = reflection->GetStringReference(msg, field, &scratch);
+                AppendQuoted(value.data(), value.length());
+            }
+            break;
+        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+            AppendMessage(reflection->GetMessage(msg, field));
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef MYSQLSQLBUILDER_H
+#define MYSQLSQLBUILDER_H
+
+#include <soul/protobuf-mysql/MysqlFormat.h>
+#include <string>
+#include <cstddef>
+#include <mysql/mysql.h>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class Reflection;
+        class FieldDescriptor;
+    }
+}
+
+namespace soul {
+    // connection dependent settings used while generating sql
+    struct MysqlSqlContext {
+        enum { DEFAULT_MAX_PACKET_SIZE = 4 * 1024 * 1024 };
+        // room for the packet header and command byte
+        enum { PACKET_RESERVE = 1024 };
+
+        // set when the connection charset is not safe for the builtin escape kernel (big5, gbk, sjis...)
+        MYSQL* escapeConnection;
+        // server max_allowed_packet, statements batching several rows are split to fit into it
+        std::size_t maxPacketSize;
+
+        MysqlSqlContext() : escapeConnection(nullptr), maxPacketSize(DEFAULT_MAX_PACKET_SIZE) {}
+
+        // longest statement, or batch of statements, that is sent as one packet
+        std::size_t PacketLimit() const {
+            return maxPacketSize > PACKET_RESERVE * 2 ? maxPacketSize - PACKET_RESERVE : maxPacketSize;
+        }
+    };
+
+    // append-only writer of one sql statement, every value is formatted straight into the buffer
+    class MysqlSqlBuilder {
+        private:
+            std::string& mBuffer;
+            MYSQL* mEscapeConnection;
+            bool mHexMessage;
+        public:
+            explicit MysqlSqlBuilder(std::string& buffer) : mBuffer(buffer), mEscapeConnection(nullptr), mHexMessage(false) {}
+            MysqlSqlBuilder(std::string& buffer, const MysqlSqlContext& context, bool hexMessage = false)
+                : mBuffer(buffer), mEscapeConnection(context.escapeConnection), mHexMessage(hexMessage) {}
+
+            void Reserve(std::size_t size) {
+                if(mBuffer.capacity() < mBuffer.size() + size) {
+                    mBuffer.reserve(mBuffer.size() + size);
+                }
+            }
+            std::size_t Length() const { return mBuffer.size(); }
+            void Truncate(std::size_t length) { mBuffer.resize(length); }
+            std::string& Buffer() { return mBuffer; }
+
+            template<std::size_t N>
+            MysqlSqlBuilder& Append(const char (&str)[N]) {
+                mBuffer.append(str, N - 1);
+                return *this;
+            }
+            MysqlSqlBuilder& Append(const std::string& str) {
+                mBuffer.append(str);
+                return *this;
+            }
+            MysqlSqlBuilder& Append(const char* str, std::size_t len) {
+                mBuffer.append(str, len);
+                return *this;
+            }
+            MysqlSqlBuilder& Append(char c) {
+                mBuffer.push_back(c);
+                return *this;
+            }
+
+            void AppendInt32(int32_t value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatInt32(value, tmp));
+            }
+            void AppendInt64(int64_t value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatInt64(value, tmp));
+            }
+            void AppendUInt32(uint32_t value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatUInt32(value, tmp));
+            }
+            void AppendUInt64(uint64_t value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatUInt64(value, tmp));
+            }
+            void AppendDouble(double value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatDouble(value, tmp));
+            }
+            void AppendFloat(float value) {
+                char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+                mBuffer.append(tmp, MysqlFormat::FormatFloat(value, tmp));
+            }
+            void AppendQuoted(const char* str, std::size_t len);
+            // X'...' literal, binary safe and independent of the connection charset
+            void AppendHex(const char* str, std::size_t len);
+            // multibyte charsets whose trailing bytes may look like '\\' or '\'' need mysql_real_escape_string
+            static bool IsEscapeSafeCharset(const char* charset);
+            // serialized bytes of a nested message, quoted or X'...' depending on the message encoding
+            void AppendMessage(const google::protobuf::Message& msg);
+            void AppendFieldValue(const google::protobuf::Reflection* reflection,
+                                  const google::protobuf::Message& msg,
+                                  const google::protobuf::FieldDescriptor* field);
+        private:
+            // literal of str written at start into room already in the buffer, return the end of it
+            std::size_t WriteQuoted(std::size_t start, const char* str, std::size_t len);
+            std::size_t WriteHex(std::size_t start, const char* str, std::size_t len);
+    };
+}
+
+#endif /*MYSQLSQLBUILDER_H*/
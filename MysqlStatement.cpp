@@ -0,0 +1,282 @@
+#include <soul/protobuf-mysql/MysqlStatement.h>
+#include <soul/protobuf-mysql/MysqlPlan.h>
+#include <soul/protobuf-mysql/MysqlError.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
+#include <cstring>
+
+using namespace soul;
+
+namespace {
+    // initial buffer of a string result column, grown to the longest value fetched so far
+    const std::size_t kResultBufferSize = 64;
+
+    // buffer type of a field, return true if values have a variable length
+    bool SetBufferType(MYSQL_BIND& bind, const google::protobuf::FieldDescriptor* field) {
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                bind.buffer_type = MYSQL_TYPE_LONG;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                bind.buffer_type = MYSQL_TYPE_LONG;
+                bind.is_unsigned = 1;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                bind.is_unsigned = 1;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                bind.buffer_type = MYSQL_TYPE_FLOAT;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                bind.buffer_type = MYSQL_TYPE_DOUBLE;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                bind.buffer_type = MYSQL_TYPE_TINY;
+                return false;
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                bind.buffer_type = field->type() == google::protobuf::FieldDescriptor::TYPE_BYTES ? MYSQL_TYPE_BLOB : MYSQL_TYPE_STRING;
+                return true;
+            default:
+                bind.buffer_type = MYSQL_TYPE_BLOB;
+                return true;
+        }
+    }
+}
+
+MysqlStatement::MysqlStatement() : mStmt(nullptr), mPlan(nullptr) {
+}
+
+MysqlStatement::~MysqlStatement() {
+    if(mStmt != nullptr) {
+        mysql_stmt_close(mStmt);
+    }
+}
+
+int MysqlStatement::Prepare(MYSQL* handler, const MysqlPlan& plan, const std::string& sql, const std::vector<int>& columns) {
+    mStmt = mysql_stmt_init(handler);
+    if(mStmt == nullptr) {
+        return mysql_errno(handler);
+    }
+    if(mysql_stmt_prepare(mStmt, sql.c_str(), sql.length()) != 0) {
+        return mysql_stmt_errno(mStmt);
+    }
+    mPlan = &plan;
+    mColumns = columns;
+    mParams.resize(columns.size());
+    mBinds.resize(columns.size());
+    std::memset(mBinds.data(), 0, mBinds.size() * sizeof(MYSQL_BIND));
+    for(std::size_t i = 0; i != columns.size(); ++i) {
+        MYSQL_BIND& bind = mBinds[i];
+        Param& param = mParams[i];
+        bind.buffer = &param.value;
+        if(SetBufferType(bind, plan.columns[columns[i]].field)) {
+            bind.length = &param.length;
+        }
+    }
+
+    MYSQL_RES* metadata = mysql_stmt_result_metadata(mStmt);
+    if(metadata == nullptr) return 0;
+    const unsigned int fieldCount = mysql_num_fields(metadata);
+    mResults.resize(fieldCount);
+    mResultBinds.resize(fieldCount);
+    std::memset(mResultBinds.data(), 0, mResultBinds.size() * sizeof(MYSQL_BIND));
+    for(unsigned int i = 0; i != fieldCount; ++i) {
+        MYSQL_BIND& bind = mResultBinds[i];
+        Param& result = mResults[i];
+        const google::protobuf::FieldDescriptor* field = plan.descriptor->FindFieldByName(mysql_fetch_field_direct(metadata, i)->name);
+        result.column = field != nullptr ? field->index() : -1;
+        bind.is_null = &result.isNull;
+        bind.error = &result.error;
+        bind.length = &result.length;
+        if(field == nullptr) {
+            bind.buffer_type = MYSQL_TYPE_NULL;
+        } else if(SetBufferType(bind, field)) {
+            result.scratch.resize(kResultBufferSize);
+            bind.buffer = &result.scratch[0];
+            bind.buffer_length = result.scratch.size();
+        } else {
+            bind.buffer = &result.value;
+        }
+    }
+    mysql_free_result(metadata);
+    if(mysql_stmt_bind_result(mStmt, mResultBinds.data()) != 0) {
+        return mysql_stmt_errno(mStmt);
+    }
+    return 0;
+}
+
+int MysqlStatement::Execute(const google::protobuf::Message& row) {
+    const google::protobuf::Reflection* reflection = row.GetReflection();
+    for(std::size_t i = 0; i != mColumns.size(); ++i) {
+        const google::protobuf::FieldDescriptor* field = mPlan->columns[mColumns[i]].field;
+        MYSQL_BIND& bind = mBinds[i];
+        Param& param = mParams[i];
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                param.value.i32 = reflection->GetInt32(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                param.value.i32 = reflection->GetEnumValue(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                param.value.u32 = reflection->GetUInt32(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                param.value.i64 = reflection->GetInt64(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                param.value.u64 = reflection->GetUInt64(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                param.value.f = reflection->GetFloat(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                param.value.d = reflection->GetDouble(row, field);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                param.value.b = reflection->GetBool(row, field) ? 1 : 0;
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                {
+                    const std::string& value = reflection->GetStringReference(row, field, &param.scratch);
+                    bind.buffer = const_cast<char*>(value.data());
+                    bind.buffer_length = value.length();
+                    param.length = value.length();
+                }
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+                param.scratch.clear();
+                reflection->GetMessage(row, field).AppendToString(&param.scratch);
+                bind.buffer = const_cast<char*>(param.scratch.data());
+                bind.buffer_length = param.scratch.length();
+                param.length = param.scratch.length();
+                break;
+            default:
+                break;
+        }
+    }
+    if(mysql_stmt_bind_param(mStmt, mBinds.data()) != 0 || mysql_stmt_execute(mStmt) != 0) {
+        return mysql_stmt_errno(mStmt);
+    }
+    return 0;
+}
+
+my_ulonglong MysqlStatement::AffectedRows() {
+    return mysql_stmt_affected_rows(mStmt);
+}
+
+const char* MysqlStatement::Error() {
+    return mStmt != nullptr ? mysql_stmt_error(mStmt) : "mysql_stmt_init failed";
+}
+
+int MysqlStatement::StoreResult() {
+    if(mysql_stmt_store_result(mStmt) != 0) {
+        return mysql_stmt_errno(mStmt);
+    }
+    return 0;
+}
+
+my_ulonglong MysqlStatement::NumRows() {
+    return mysql_stmt_num_rows(mStmt);
+}
+
+void MysqlStatement::FreeResult() {
+    mysql_stmt_free_result(mStmt);
+}
+
+int MysqlStatement::Fetch(google::protobuf::Message& row) {
+    int ret = mysql_stmt_fetch(mStmt);
+    if(ret == MYSQL_NO_DATA) return MYSQL_NO_DATA;
+    if(ret != 0 && ret != MYSQL_DATA_TRUNCATED) return mysql_stmt_errno(mStmt);
+    const google::protobuf::Reflection* reflection = row.GetReflection();
+    bool grown = false;
+    for(std::size_t i = 0; i != mResults.size(); ++i) {
+        Param& result = mResults[i];
+        if(result.column < 0) continue;
+        MYSQL_BIND& bind = mResultBinds[i];
+        const google::protobuf::FieldDescriptor* field = mPlan->columns[result.column].field;
+        if(result.isNull) continue;
+        const bool variable = bind.buffer_type == MYSQL_TYPE_STRING || bind.buffer_type == MYSQL_TYPE_BLOB;
+        if(variable && result.length > bind.buffer_length) {
+            // the value did not fit, fetch it again into a buffer large enough
+            result.scratch.resize(result.length);
+            bind.buffer = &result.scratch[0];
+            bind.buffer_length = result.scratch.size();
+            if(mysql_stmt_fetch_column(mStmt, &bind, i, 0) != 0) {
+                return mysql_stmt_errno(mStmt);
+            }
+            grown = true;
+        } else if(!variable && result.error) {
+            return SQL_DECODE_FAIL;
+        }
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                reflection->SetInt32(&row, field, result.value.i32);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                reflection->SetUInt32(&row, field, result.value.u32);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                reflection->SetInt64(&row, field, result.value.i64);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                reflection->SetUInt64(&row, field, result.value.u64);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                reflection->SetFloat(&row, field, result.value.f);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                reflection->SetDouble(&row, field, result.value.d);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                reflection->SetBool(&row, field, result.value.b != 0);
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                {
+                    const google::protobuf::EnumValueDescriptor* enumValue = field->enum_type()->FindValueByNumber(result.value.i32);
+                    if(enumValue == nullptr) return SQL_DECODE_FAIL;
+                    reflection->SetEnum(&row, field, enumValue);
+                }
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+                reflection->SetString(&row, field, std::string(result.scratch.data(), result.length));
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+                if(!reflection->MutableMessage(&row, field)->ParseFromArray(result.scratch.data(), result.length)) {
+                    return SQL_DECODE_FAIL;
+                }
+                break;
+            default:
+                return SQL_DECODE_FAIL;
+        }
+    }
+    if(grown && mysql_stmt_bind_result(mStmt, mResultBinds.data()) != 0) {
+        return mysql_stmt_errno(mStmt);
+    }
+    return 0;
+}
+
+MysqlStatement* MysqlStatementCache::Find(const MysqlPlan* plan, int type, uint64_t mask, const std::string& where) const {
+    Key key = {plan, type, mask, where};
+    auto it = mStatements.find(key);
+    return it != mStatements.end() ? it->second.get() : nullptr;
+}
+
+MysqlStatement* MysqlStatementCache::Insert(const MysqlPlan* plan, int type, uint64_t mask, const std::string& where, std::unique_ptr<MysqlStatement> statement) {
+    if(mStatements.size() >= MAX_STATEMENTS) {
+        mStatements.clear();
+    }
+    Key key = {plan, type, mask, where};
+    MysqlStatement* result = statement.get();
+    mStatements[key] = std::move(statement);
+    return result;
+}
+
+void MysqlStatementCache::Clear() {
+    mStatements.clear();
+}
@@ -0,0 +1,105 @@
+#ifndef MYSQLSTATEMENT_H
+#define MYSQLSTATEMENT_H
+
+#include <mysql/mysql.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+    }
+}
+
+namespace soul {
+    struct MysqlPlan;
+
+    // one server side prepared statement, its parameters are bound straight from the fields of a row message
+    class MysqlStatement {
+        private:
+            // storage of one parameter or result column, numbers are copied in and out,
+            // string parameters point into the message, string results land in scratch
+            struct Param {
+                union {
+                    int32_t i32;
+                    uint32_t u32;
+                    int64_t i64;
+                    uint64_t u64;
+                    float f;
+                    double d;
+                    char b;
+                } value;
+                unsigned long length;
+                my_bool isNull;
+                my_bool error;
+                int column;                 // result column: field index, -1 if the column is no field
+                std::string scratch;
+            };
+            MYSQL_STMT* mStmt;
+            const MysqlPlan* mPlan;
+            std::vector<int> mColumns;      // column bound to each parameter
+            std::vector<MYSQL_BIND> mBinds;
+            std::vector<Param> mParams;
+            std::vector<MYSQL_BIND> mResultBinds;
+            std::vector<Param> mResults;
+        public:
+            MysqlStatement();
+            ~MysqlStatement();
+            MysqlStatement(const MysqlStatement&) = delete;
+            MysqlStatement& operator=(const MysqlStatement&) = delete;
+
+            // return 0 or the mysql error number, Error() tells why
+            int Prepare(MYSQL* handler, const MysqlPlan& plan, const std::string& sql, const std::vector<int>& columns);
+            int Execute(const google::protobuf::Message& row);
+            my_ulonglong AffectedRows();
+            const char* Error();
+            MYSQL_STMT* Handle() const { return mStmt; }
+
+            // select statements: the rows of the last Execute are buffered on the client by StoreResult,
+            // Fetch decodes the next one into row. cells are copied out of the binary protocol without any
+            // text conversion, fields the statement does not select and NULL cells are left untouched.
+            // Fetch returns 0, MYSQL_NO_DATA after the last row, SQL_DECODE_FAIL if a value does not fit
+            // its field or the mysql error number
+            bool HasResult() const { return !mResults.empty(); }
+            int StoreResult();
+            my_ulonglong NumRows();
+            int Fetch(google::protobuf::Message& row);
+            void FreeResult();
+    };
+
+    // statements prepared on one connection, keyed by row plan, statement type, the columns the row sets and the where condition
+    class MysqlStatementCache {
+        private:
+            // plans are shared by every where condition on a table, the statement text is not
+            struct Key {
+                const MysqlPlan* plan;
+                int type;
+                uint64_t mask;
+                std::string where;
+                bool operator==(const Key& other) const {
+                    return plan == other.plan && type == other.type && mask == other.mask && where == other.where;
+                }
+            };
+            struct KeyHash {
+                std::size_t operator()(const Key& key) const {
+                    std::size_t h = std::hash<const void*>()(key.plan) ^ (std::hash<uint64_t>()(key.mask) * 31) ^ std::hash<std::string>()(key.where);
+                    return h ^ (std::size_t(key.type) + 0x9e3779b9 + (h << 6) + (h >> 2));
+                }
+            };
+            std::unordered_map<Key, std::unique_ptr<MysqlStatement>, KeyHash> mStatements;
+        public:
+            // every cached statement holds a server side handle, the whole cache is dropped when it grows past this
+            enum { MAX_STATEMENTS = 256 };
+
+            // where is the where condition of the generator the statement was generated by
+            MysqlStatement* Find(const MysqlPlan* plan, int type, uint64_t mask, const std::string& where) const;
+            MysqlStatement* Insert(const MysqlPlan* plan, int type, uint64_t mask, const std::string& where, std::unique_ptr<MysqlStatement> statement);
+            void Clear();
+            std::size_t Size() const { return mStatements.size(); }
+    };
+}
+
+#endif /*MYSQLSTATEMENT_H*/
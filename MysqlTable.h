@@ -0,0 +1,56 @@
+#ifndef MYSQLTABLE_H
+#define MYSQLTABLE_H
+
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlInterface.h>
+#include <google/protobuf/message.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace soul {
+    // typed access to one table whose rows are messages of type T.
+    // the plan of T (columns, keys, sql fragments) is resolved once when the table is constructed,
+    // so calls never go through the descriptor lookup of the untyped api.
+    // keep the object alive as long as the table is used, e.g. as a static or a member
+    template<typename T>
+    class MysqlTable {
+        static_assert(std::is_base_of<google::protobuf::Message, T>::value, "T must be a generated protobuf message");
+        private:
+            MysqlGenerator mGenerator;
+        public:
+            MysqlTable(const std::string& database, const std::string& table, const std::string& where = "")
+                : mGenerator(database, table, where)
+            {
+                mGenerator.SetMessageType(T::descriptor());
+            }
+
+            const MysqlGenerator& Generator() const { return mGenerator; }
+            MysqlGenerator& Generator() { return mGenerator; }
+
+            // fields of row left empty are selected, fields set are the condition
+            int Select(MysqlInterface& interface, T& row) const {
+                return interface.ExecuteSqlSelect(mGenerator, row);
+            }
+            int Insert(MysqlInterface& interface, const T& row) const {
+                return interface.ExecuteSqlInsert(mGenerator, row);
+            }
+            int Update(MysqlInterface& interface, const T& row) const {
+                return interface.ExecuteSqlUpdate(mGenerator, row);
+            }
+            int Upsert(MysqlInterface& interface, const T& row) const {
+                return interface.ExecuteSqlUpdateOnInsert(mGenerator, row);
+            }
+            int Delete(MysqlInterface& interface, const T& row) const {
+                return interface.ExecuteSqlDelete(mGenerator, row);
+            }
+
+            std::string GenerateSqlSelect(const T& row) const { return mGenerator.GenerateSqlSelect(row); }
+            std::string GenerateSqlInsert(const T& row) const { return mGenerator.GenerateSqlInsert(row); }
+            std::vector<std::string> GenerateSqlUpdate(const T& row) const { return mGenerator.GenerateSqlUpdate(row); }
+            std::string GenerateSqlUpsert(const T& row) const { return mGenerator.GenerateSqlUpdateOnInsert(row); }
+            std::vector<std::string> GenerateSqlDelete(const T& row) const { return mGenerator.GenerateSqlDelete(row); }
+    };
+}
+
+#endif /*MYSQLTABLE_H*/
@@ -0,0 +1,160 @@
+#include <soul/protobuf-mysql/MysqlUpdateCoalescer.h>
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlDescriptor.pb.h>
+#include <soul/Log.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
+
+using namespace soul;
+
+MysqlUpdateCoalescer::MysqlUpdateCoalescer(MysqlConnectionPool& pool, const MysqlGenerator& generator,
+                                           const google::protobuf::Message& prototype, const MysqlUpdateCoalescerConfig& config)
+    : mPool(pool), mGenerator(generator), mConfig(config), mRows(nullptr), mPending(prototype.New()), mWriting(prototype.New()),
+      mTaken(0), mDone(0), mFlushRequested(false), mStopped(false), mClosed(false), mUpdates(0), mWritten(0), mDropped(0)
+{
+    if(mConfig.maxKeys == 0) {
+        mConfig.maxKeys = 1;
+    }
+    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(prototype)) {
+        mRows = prototype.GetDescriptor()->field(0);
+        const google::protobuf::Descriptor* descriptor = mRows->message_type();
+        for(int i = 0; i != descriptor->field_count(); ++i) {
+            const google::protobuf::FieldDescriptor* field = descriptor->field(i);
+            if(field->is_repeated()) continue;
+            if(mConfig.upsert ? field->options().GetExtension(primarykey) : field->options().GetExtension(updatekey)) {
+                mKeys.push_back(field);
+            }
+        }
+        if(mKeys.empty()) {
+            LOG_ERROR << "update coalescer of " << descriptor->full_name() << " refuses every row: not found option '"
+                      << (mConfig.upsert ? "primarykey" : "updatekey") << "'";
+            mClosed = true;
+        }
+    } else {
+        LOG_ERROR << "update coalescer of " << prototype.GetDescriptor()->full_name() << " refuses every row: "
+                  << "the prototype must hold only one repeated message field";
+        mClosed = true;
+    }
+    mThread = std::thread([this]() { Run(); });
+}
+
+MysqlUpdateCoalescer::~MysqlUpdateCoalescer() {
+    Close();
+}
+
+bool MysqlUpdateCoalescer::GetKey(const google::protobuf::Message& row, std::string& key) const {
+    const google::protobuf::Reflection* reflection = row.GetReflection();
+    for(std::size_t i = 0; i != mKeys.size(); ++i) {
+        if(reflection->HasField(row, mKeys[i]) == false) return false;
+        // values are formatted as sql literals, strings quoted and escaped, so the joined key is unambiguous
+        key += MysqlGenerator::GetFieldValue(reflection, row, mKeys[i]);
+        key += ',';
+    }
+    return true;
+}
+
+bool MysqlUpdateCoalescer::Update(const google::protobuf::Message& row) {
+    if(mClosed) return false;
+    if(row.GetDescriptor() != mRows->message_type()) {
+        LOG_ERROR << "update coalescer refuses a row that is not a " << mRows->message_type()->full_name();
+        return false;
+    }
+    std::string key;
+    if(GetKey(row, key) == false) {
+        LOG_ERROR << "update coalescer refuses a row without all of its key fields: " << row.ShortDebugString();
+        return false;
+    }
+    bool full = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(mStopped) return false;
+        const google::protobuf::Reflection* reflection = mPending->GetReflection();
+        auto it = mIndex.find(key);
+        if(it != mIndex.end()) {
+            reflection->MutableRepeatedMessage(mPending.get(), mRows, it->second)->MergeFrom(row);
+        } else {
+            mIndex.emplace(std::move(key), reflection->FieldSize(*mPending, mRows));
+            reflection->AddMessage(mPending.get(), mRows)->CopyFrom(row);
+            full = mIndex.size() == mConfig.maxKeys;
+        }
+    }
+    mUpdates.fetch_add(1);
+    if(full) {
+        mWake.notify_one();
+    }
+    return true;
+}
+
+std::size_t MysqlUpdateCoalescer::Pending() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mIndex.size();
+}
+
+bool MysqlUpdateCoalescer::Flush(int timeout) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    // the batch being written, if any, is mTaken, the pending rows become the next one
+    const uint64_t target = mTaken + (mIndex.empty() ? 0 : 1);
+    if(target == mDone) return true;
+    mFlushRequested = true;
+    mWake.notify_one();
+    auto flushed = [this, target]() { return mDone >= target; };
+    if(timeout < 0) {
+        mFlushed.wait(lock, flushed);
+        return true;
+    }
+    return mFlushed.wait_for(lock, std::chrono::milliseconds(timeout), flushed);
+}
+
+void MysqlUpdateCoalescer::Close() {
+    mClosed = true;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mWake.notify_one();
+    if(mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void MysqlUpdateCoalescer::Run() {
+    mysql_thread_init();
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait_for(lock, std::chrono::milliseconds(mConfig.flushInterval), [this]() {
+                return mStopped || mFlushRequested || mIndex.size() >= mConfig.maxKeys;
+            });
+            if(mIndex.empty()) {
+                if(mStopped) break;
+                // a flush that came in while the last batch was written has nothing more to wait for
+                mFlushRequested = false;
+                continue;
+            }
+            // updates arriving from now on start a new batch, written after this one
+            mPending.swap(mWriting);
+            mIndex.clear();
+            mFlushRequested = false;
+            ++mTaken;
+        }
+        Write();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mDone;
+        }
+        mFlushed.notify_all();
+    }
+    mysql_thread_end();
+}
+
+void MysqlUpdateCoalescer::Write() {
+    const int rows = mWriting->GetReflection()->FieldSize(*mWriting, mRows);
+    int ret = mPool.ExecuteSqlRetry(mGenerator, mConfig.upsert ? MysqlGenerator::STATEMENT_UPDATE_ON_INSERT : MysqlGenerator::STATEMENT_UPDATE,
+                                    *mWriting, mConfig.retryLimit, mConfig.flushInterval, mConfig.onError);
+    if(ret != 0) {
+        mDropped.fetch_add(rows);
+    } else {
+        mWritten.fetch_add(rows);
+    }
+    mWriting->Clear();
+}
@@ -0,0 +1,92 @@
+#ifndef MYSQLUPDATECOALESCER_H
+#define MYSQLUPDATECOALESCER_H
+
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class FieldDescriptor;
+    }
+}
+
+namespace soul {
+    class MysqlGenerator;
+
+    struct MysqlUpdateCoalescerConfig {
+        bool upsert;                    // rows are keyed by 'primarykey' fields and written by insert ... on duplicate key update,
+                                        // otherwise keyed by 'updatekey' fields and written by update
+        std::size_t maxKeys;            // a flush starts once this many keys are pending
+        int flushInterval;              // ms an update waits at most before it is written
+        int retryLimit;                 // times the rows are tried again while the connection is lost, see MysqlConnectionPool::ExecuteSqlRetry
+        // rows given up: their statements failed or the connection stayed lost
+        MysqlConnectionPool::WriteErrorHandler onError;
+
+        MysqlUpdateCoalescerConfig() : upsert(false), maxKeys(1000), flushInterval(100), retryLimit(3) {}
+    };
+
+    // collects partial updates of rows and writes only the latest state of each row, every maxKeys keys or
+    // every flushInterval. an update of a row still pending is merged into it with MergeFrom: fields it sets
+    // overwrite the pending ones, fields it leaves unset keep their pending value, repeated fields are appended.
+    // a row is identified by the values of its key fields, which every update has to set. generator must not
+    // have a where condition. updates of a row are written in order, later ones never before earlier ones
+    class MysqlUpdateCoalescer {
+        private:
+            MysqlConnectionPool& mPool;
+            const MysqlGenerator& mGenerator;
+            MysqlUpdateCoalescerConfig mConfig;
+            const google::protobuf::FieldDescriptor* mRows;
+            std::vector<const google::protobuf::FieldDescriptor*> mKeys;
+            std::mutex mMutex;
+            std::condition_variable mWake;                  // flush thread: keys to write, flush requested, close
+            std::condition_variable mFlushed;
+            std::unique_ptr<google::protobuf::Message> mPending;    // holds one repeated field of the row type
+            std::unique_ptr<google::protobuf::Message> mWriting;
+            std::unordered_map<std::string, int> mIndex;    // key values of a pending row to its index in mPending
+            uint64_t mTaken;                                // batches moved out of mPending
+            uint64_t mDone;                                 // batches written or given up
+            bool mFlushRequested;
+            bool mStopped;
+            std::atomic<bool> mClosed;
+            std::atomic<uint64_t> mUpdates;
+            std::atomic<uint64_t> mWritten;
+            std::atomic<uint64_t> mDropped;
+            std::thread mThread;
+        public:
+            // prototype is a message holding only one repeated message field, e.g. table_test_repeated,
+            // and updated rows are of its element type. generator and pool must outlive the coalescer
+            MysqlUpdateCoalescer(MysqlConnectionPool& pool, const MysqlGenerator& generator,
+                                 const google::protobuf::Message& prototype, const MysqlUpdateCoalescerConfig& config);
+            // Close
+            ~MysqlUpdateCoalescer();
+            MysqlUpdateCoalescer(const MysqlUpdateCoalescer&) = delete;
+            MysqlUpdateCoalescer& operator=(const MysqlUpdateCoalescer&) = delete;
+
+            // merge row into the pending update of its key. false if the coalescer is closed, row is of the
+            // wrong type or does not set every key field
+            bool Update(const google::protobuf::Message& row);
+            // wait up to timeout ms (-1 forever) until every update made before the call is written or given up
+            bool Flush(int timeout);
+            // refuse further updates, write the pending ones and stop the flush thread
+            void Close();
+
+            std::size_t Pending();
+            uint64_t Updates() const { return mUpdates.load(); }       // Update calls accepted
+            uint64_t Written() const { return mWritten.load(); }       // rows written, each one the merge of one or more updates
+            uint64_t Dropped() const { return mDropped.load(); }
+        private:
+            bool GetKey(const google::protobuf::Message& row, std::string& key) const;
+            void Run();
+            void Write();
+    };
+}
+
+#endif /*MYSQLUPDATECOALESCER_H*/
@@ -0,0 +1,125 @@
+#include <soul/protobuf-mysql/MysqlWorker.h>
+#include <soul/protobuf-mysql/MysqlError.h>
+#include <soul/Log.h>
+#include <mysql/errmsg.h>
+
+using namespace soul;
+
+MysqlWorker::MysqlWorker(const MysqlPoolConfig& config) : mConfig(config), mStopped(false) {
+    mysql_library_init(0, nullptr, nullptr);
+    mThread = std::thread([this]() { Run(); });
+}
+
+MysqlWorker::~MysqlWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mWake.notify_one();
+    mThread.join();
+}
+
+void MysqlWorker::ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, const Callback& callback) {
+    Post([&generator, &result](MysqlInterface& interface, MysqlAsyncResult&) {
+        return interface.ExecuteSqlSelect(generator, result);
+    }, callback);
+}
+
+void MysqlWorker::ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    Post([&generator, &msg](MysqlInterface& interface, MysqlAsyncResult& result) {
+        int ret = interface.ExecuteSqlInsert(generator, msg);
+        result.affectedRows = interface.AffectedRows();
+        return ret;
+    }, callback);
+}
+
+void MysqlWorker::ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    Post([&generator, &msg](MysqlInterface& interface, MysqlAsyncResult& result) {
+        int ret = interface.ExecuteSqlUpdate(generator, msg);
+        result.affectedRows = interface.AffectedRows();
+        return ret;
+    }, callback);
+}
+
+void MysqlWorker::ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    Post([&generator, &msg](MysqlInterface& interface, MysqlAsyncResult& result) {
+        int ret = interface.ExecuteSqlUpdateOnInsert(generator, msg);
+        result.affectedRows = interface.AffectedRows();
+        return ret;
+    }, callback);
+}
+
+void MysqlWorker::ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback) {
+    Post([&generator, &msg](MysqlInterface& interface, MysqlAsyncResult& result) {
+        int ret = interface.ExecuteSqlDelete(generator, msg);
+        result.affectedRows = interface.AffectedRows();
+        return ret;
+    }, callback);
+}
+
+void MysqlWorker::Commit(const Callback& callback) {
+    Post([](MysqlInterface& interface, MysqlAsyncResult&) {
+        return interface.Commit() ? 0 : SQL_ROLLBACK;
+    }, callback);
+}
+
+void MysqlWorker::Rollback(const Callback& callback) {
+    Post([](MysqlInterface& interface, MysqlAsyncResult&) {
+        if(interface.AutoCommit()) return static_cast<int>(SQL_NO_TRANSACTION);
+        return interface.Rollback() ? 0 : static_cast<int>(SQL_ROLLBACK);
+    }, callback);
+}
+
+void MysqlWorker::Post(const Operation& operation, const Callback& callback) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push_back([this, operation, callback]() { Execute(operation, callback); });
+    }
+    mWake.notify_one();
+}
+
+void MysqlWorker::Execute(const Operation& operation, const Callback& callback) {
+    MysqlAsyncResult result;
+    if(!mInterface) {
+        mInterface = MysqlConnectionPool::Open(mConfig);
+    }
+    if(!mInterface) {
+        result.error = SQL_NO_CONNECTION;
+    } else {
+        result.error = operation(*mInterface, result);
+        if(result.error != 0 && result.error < SQL_GENERATE_FAIL) {
+            // text queries return 1 and leave the error number in mysql_errno
+            const unsigned int error = mInterface->LastErrno();
+            if(error != 0) {
+                result.error = error;
+            }
+        }
+        if(result.error != 0) {
+            result.errorStr = mInterface->LastError();
+        }
+        if(result.error == CR_SERVER_GONE_ERROR || result.error == CR_SERVER_LOST) {
+            // the failed operation is not repeated, it may have been applied
+            mInterface.reset();
+        }
+    }
+    if(callback) {
+        callback(result);
+    }
+}
+
+void MysqlWorker::Run() {
+    mysql_thread_init();
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait(lock, [this]() { return mStopped || !mTasks.empty(); });
+            if(mTasks.empty()) break;
+            task = std::move(mTasks.front());
+            mTasks.pop_front();
+        }
+        task();
+    }
+    mInterface.reset();
+    mysql_thread_end();
+}
@@ -0,0 +1,51 @@
+#ifndef MYSQLWORKER_H
+#define MYSQLWORKER_H
+
+#include <soul/protobuf-mysql/MysqlAsyncExecutor.h>
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace soul {
+    // one MysqlInterface on a thread of its own. operations run one after another in submit order, so with
+    // config.autoCommit false everything submitted between two Commit / Rollback is one transaction.
+    // callbacks run on the worker thread, use several workers for operations in parallel
+    class MysqlWorker : public MysqlAsyncExecutor {
+        private:
+            typedef std::function<int(MysqlInterface& interface, MysqlAsyncResult& result)> Operation;
+
+            MysqlPoolConfig mConfig;
+            std::unique_ptr<MysqlInterface> mInterface;     // touched by the worker thread only
+            std::mutex mMutex;
+            std::condition_variable mWake;
+            std::deque<std::function<void()>> mTasks;
+            bool mStopped;
+            std::thread mThread;
+        public:
+            // connects on the worker thread when the first operation runs, a lost connection is opened again
+            // for the next one
+            explicit MysqlWorker(const MysqlPoolConfig& config);
+            // runs what is still queued, then closes the connection
+            ~MysqlWorker();
+            MysqlWorker(const MysqlWorker&) = delete;
+            MysqlWorker& operator=(const MysqlWorker&) = delete;
+
+            virtual void ExecuteSqlSelect(const MysqlGenerator& generator, google::protobuf::Message& result, const Callback& callback);
+            virtual void ExecuteSqlInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void ExecuteSqlUpdate(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void ExecuteSqlUpdateOnInsert(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void ExecuteSqlDelete(const MysqlGenerator& generator, const google::protobuf::Message& msg, const Callback& callback);
+            virtual void Commit(const Callback& callback);
+            virtual void Rollback(const Callback& callback);
+        private:
+            void Post(const Operation& operation, const Callback& callback);
+            void Execute(const Operation& operation, const Callback& callback);
+            void Run();
+    };
+}
+
+#endif /*MYSQLWORKER_H*/
@@ -0,0 +1,217 @@
+#include <soul/protobuf-mysql/MysqlWriteBehind.h>
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/Log.h>
+#include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
+
+using namespace soul;
+
+MysqlWriteBehind::MysqlWriteBehind(MysqlConnectionPool& pool, const MysqlGenerator& generator,
+                                   const google::protobuf::Message& prototype, const MysqlWriteBehindConfig& config)
+    : mPool(pool), mGenerator(generator), mConfig(config), mBatch(prototype.New()), mRows(nullptr),
+      mHead(&mStub), mTail(&mStub), mQueued(0), mPushed(0), mDone(0), mDropped(0), mClosed(false), mWaiting(0),
+      mFlushTarget(0), mStopped(false)
+{
+    mStub.next.store(nullptr);
+    mStub.row = nullptr;
+    if(mConfig.batchRows == 0) {
+        mConfig.batchRows = 1;
+    }
+    if(mConfig.maxRows < mConfig.batchRows) {
+        mConfig.maxRows = mConfig.batchRows;
+    }
+    if(MysqlGenerator::OnlyHoldsOneRepeatedMessageField(prototype)) {
+        mRows = prototype.GetDescriptor()->field(0);
+    } else {
+        LOG_ERROR << "write behind of " << prototype.GetDescriptor()->full_name() << " refuses every row: "
+                  << "the prototype must hold only one repeated message field";
+        mClosed = true;
+    }
+    mThread = std::thread([this]() { Run(); });
+}
+
+MysqlWriteBehind::~MysqlWriteBehind() {
+    Close();
+}
+
+void MysqlWriteBehind::Enqueue(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* prev = mHead.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+MysqlWriteBehind::Node* MysqlWriteBehind::Dequeue() {
+    Node* tail = mTail;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if(tail == &mStub) {
+        if(next == nullptr) return nullptr;
+        mTail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+    if(next != nullptr) {
+        mTail = next;
+        return tail;
+    }
+    // tail is the last node linked, or a producer swapped in a node after it and has not linked it yet
+    if(tail != mHead.load(std::memory_order_acquire)) return nullptr;
+    Enqueue(&mStub);
+    next = tail->next.load(std::memory_order_acquire);
+    if(next != nullptr) {
+        mTail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+bool MysqlWriteBehind::TryReserve(std::size_t& queued) {
+    queued = mQueued.load();
+    while(queued < mConfig.maxRows) {
+        if(mQueued.compare_exchange_weak(queued, queued + 1)) return true;
+    }
+    return false;
+}
+
+bool MysqlWriteBehind::Reserve(std::size_t& queued) {
+    if(TryReserve(queued)) return true;
+    if(mConfig.pushTimeout == 0) return false;
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mConfig.pushTimeout);
+    std::unique_lock<std::mutex> lock(mMutex);
+    ++mWaiting;
+    bool reserved = false;
+    bool expired = false;
+    while(!mClosed && !expired) {
+        if(TryReserve(queued)) {
+            reserved = true;
+            break;
+        }
+        if(mConfig.pushTimeout < 0) {
+            mRoom.wait(lock);
+        } else {
+            expired = mRoom.wait_until(lock, deadline) == std::cv_status::timeout;
+        }
+    }
+    --mWaiting;
+    return reserved;
+}
+
+bool MysqlWriteBehind::Push(const google::protobuf::Message& row) {
+    if(mClosed) return false;
+    std::unique_ptr<google::protobuf::Message> copy(row.New());
+    copy->CopyFrom(row);
+    return Push(std::move(copy));
+}
+
+bool MysqlWriteBehind::Push(std::unique_ptr<google::protobuf::Message> row) {
+    if(!row || mRows == nullptr || row->GetDescriptor() != mRows->message_type()) {
+        LOG_ERROR << "write behind refuses a row that is not a " << (mRows != nullptr ? mRows->message_type()->full_name() : "row");
+        return false;
+    }
+    std::size_t queued = 0;
+    if(Reserve(queued) == false) {
+        LOG_WARN << "write behind full, " << mConfig.maxRows << " rows queued";
+        return false;
+    }
+    // checked after reserving, Close waits for every reservation to be pushed or given back
+    if(mClosed) {
+        mQueued.fetch_sub(1);
+        return false;
+    }
+    Node* node = new Node();
+    node->row = row.release();
+    Enqueue(node);
+    mPushed.fetch_add(1);
+    if(queued + 1 == mConfig.batchRows) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWake.notify_one();
+    }
+    return true;
+}
+
+bool MysqlWriteBehind::Flush(int timeout) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    // rows linked before the call, each of them reaches mDone. a push still between reserving and
+    // linking is concurrent with the flush and not waited for
+    const uint64_t target = mPushed.load();
+    if(target > mFlushTarget) {
+        mFlushTarget = target;
+    }
+    mWake.notify_one();
+    auto flushed = [this, target]() { return mDone.load() >= target || (mStopped && mQueued.load() == 0); };
+    if(timeout < 0) {
+        mFlushed.wait(lock, flushed);
+        return true;
+    }
+    return mFlushed.wait_for(lock, std::chrono::milliseconds(timeout), flushed);
+}
+
+void MysqlWriteBehind::Close() {
+    mClosed = true;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mWake.notify_one();
+    mRoom.notify_all();
+    if(mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void MysqlWriteBehind::Run() {
+    mysql_thread_init();
+    while(true) {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWake.wait_for(lock, std::chrono::milliseconds(mConfig.flushInterval), [this]() {
+                return mStopped || mQueued.load() >= mConfig.batchRows || mFlushTarget > mDone.load();
+            });
+            stopping = mStopped;
+        }
+        std::size_t rows = 0;
+        while((rows = Collect()) != 0) {
+            Write(rows);
+            if(rows < mConfig.batchRows) break;
+        }
+        if(stopping && mQueued.load() == 0) break;
+        if(rows == 0 && mQueued.load() != 0) {
+            // a producer is between swapping in its row and linking it
+            std::this_thread::yield();
+        }
+    }
+    mysql_thread_end();
+}
+
+std::size_t MysqlWriteBehind::Collect() {
+    const google::protobuf::Reflection* reflection = mBatch->GetReflection();
+    std::size_t rows = 0;
+    while(rows != mConfig.batchRows) {
+        Node* node = Dequeue();
+        if(node == nullptr) break;
+        reflection->AddAllocatedMessage(mBatch.get(), mRows, node->row);
+        delete node;
+        ++rows;
+    }
+    return rows;
+}
+
+void MysqlWriteBehind::Write(std::size_t rows) {
+    // a plain insert is not repeated once it may have reached the server, it could write the rows twice
+    int ret = mPool.ExecuteSqlRetry(mGenerator, mConfig.upsert ? MysqlGenerator::STATEMENT_UPDATE_ON_INSERT : MysqlGenerator::STATEMENT_INSERT,
+                                    *mBatch, mConfig.retryLimit, mConfig.flushInterval, mConfig.onError);
+    if(ret != 0) {
+        mDropped.fetch_add(rows);
+    }
+    mBatch->Clear();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQueued.fetch_sub(rows);
+        mDone.fetch_add(rows);
+    }
+    mFlushed.notify_all();
+    if(mWaiting.load() != 0) {
+        mRoom.notify_all();
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef MYSQLWRITEBEHIND_H
+#define MYSQLWRITEBEHIND_H
+
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace google {
+    namespace protobuf {
+        class Message;
+        class FieldDescriptor;
+    }
+}
+
+namespace soul {
+    class MysqlGenerator;
+
+    struct MysqlWriteBehindConfig {
+        bool upsert;                    // insert ... on duplicate key update instead of insert
+        std::size_t batchRows;          // a flush starts once this many rows are queued, and writes at most this many per call
+        int flushInterval;              // ms queued rows wait at most before they are written
+        std::size_t maxRows;            // rows queued at most, Push waits for room beyond
+        int pushTimeout;                // ms Push waits for room, 0 fails at once, -1 waits forever
+        int retryLimit;                 // times a batch is tried again while the connection is lost, see MysqlConnectionPool::ExecuteSqlRetry
+        // rows given up: their statement failed or the connection stayed lost
+        MysqlConnectionPool::WriteErrorHandler onError;
+
+        MysqlWriteBehindConfig()
+            : upsert(false), batchRows(500), flushInterval(100), maxRows(100000), pushTimeout(0), retryLimit(3) {}
+    };
+
+    // buffers rows on their way to one table and writes them from a background thread as multi row inserts
+    // (or upserts), batchRows at a time or every flushInterval. Push links the row into a lock-free queue and
+    // returns, waiting only while maxRows rows are queued. rows are written in push order on connections
+    // checked out of pool, a row is gone from the caller's view once Push returns: failures are logged,
+    // counted and handed to config.onError
+    class MysqlWriteBehind {
+        private:
+            struct Node {
+                std::atomic<Node*> next;
+                google::protobuf::Message* row;
+            };
+
+            MysqlConnectionPool& mPool;
+            const MysqlGenerator& mGenerator;
+            MysqlWriteBehindConfig mConfig;
+            std::unique_ptr<google::protobuf::Message> mBatch;     // holds one repeated field of the row type
+            const google::protobuf::FieldDescriptor* mRows;
+            // intrusive multi producer single consumer queue: producers swap themselves into mHead,
+            // the flush thread reads from mTail
+            std::atomic<Node*> mHead;
+            Node* mTail;
+            Node mStub;
+            std::atomic<std::size_t> mQueued;               // rows pushed or being pushed and not done yet, never above maxRows
+            std::atomic<uint64_t> mPushed;                  // rows linked into the queue
+            std::atomic<uint64_t> mDone;                    // rows written or given up
+            std::atomic<uint64_t> mDropped;
+            std::atomic<bool> mClosed;
+            std::atomic<int> mWaiting;                      // producers waiting for room
+            std::mutex mMutex;
+            std::condition_variable mWake;                  // flush thread: rows to write, flush requested, close
+            std::condition_variable mRoom;                  // producers: rows were written
+            std::condition_variable mFlushed;
+            uint64_t mFlushTarget;                          // mDone Flush waits for
+            bool mStopped;
+            std::thread mThread;
+        public:
+            // prototype is a message holding only one repeated message field, e.g. table_test_repeated,
+            // and pushed rows are of its element type. generator and pool must outlive the buffer
+            MysqlWriteBehind(MysqlConnectionPool& pool, const MysqlGenerator& generator,
+                             const google::protobuf::Message& prototype, const MysqlWriteBehindConfig& config);
+            // Close
+            ~MysqlWriteBehind();
+            MysqlWriteBehind(const MysqlWriteBehind&) = delete;
+            MysqlWriteBehind& operator=(const MysqlWriteBehind&) = delete;
+
+            // queue a copy of row, false if the buffer is closed, row is of the wrong type or there
+            // was no room within pushTimeout
+            bool Push(const google::protobuf::Message& row);
+            bool Push(std::unique_ptr<google::protobuf::Message> row);
+            // wait up to timeout ms (-1 forever) until every row pushed before the call is written or given up
+            bool Flush(int timeout);
+            // refuse further rows, write the queued ones and stop the flush thread
+            void Close();
+
+            std::size_t Queued() const { return mQueued.load(std::memory_order_relaxed); }
+            uint64_t Written() const { return mDone.load() - mDropped.load(); }
+            uint64_t Dropped() const { return mDropped.load(); }
+        private:
+            void Enqueue(Node* node);
+            Node* Dequeue();
+            bool TryReserve(std::size_t& queued);
+            bool Reserve(std::size_t& queued);
+            void Run();
+            std::size_t Collect();
+            void Write(std::size_t rows);
+    };
+}
+
+#endif /*MYSQLWRITEBEHIND_H*/
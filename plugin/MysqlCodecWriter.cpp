@@ -0,0 +1,381 @@
+#include "MysqlCodecWriter.h"
+#include <soul/protobuf-mysql/MysqlDescriptor.pb.h>
+#include <google/protobuf/descriptor.h>
+#include <cctype>
+
+using namespace soul;
+
+namespace {
+    const char* const kKeywords[] = {
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+        "catch", "char", "class", "compl", "const", "constexpr", "const_cast", "continue", "decltype",
+        "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+        "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace",
+        "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected",
+        "public", "register", "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw",
+        "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+        "volatile", "wchar_t", "while", "xor", "xor_eq",
+    };
+
+    std::string StripProto(const std::string& filename) {
+        const std::string suffix = ".proto";
+        if(filename.size() > suffix.size() && filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return filename.substr(0, filename.size() - suffix.size());
+        }
+        return filename;
+    }
+
+    std::string Replace(std::string str, const std::string& from, const std::string& to) {
+        std::size_t pos = 0;
+        while((pos = str.find(from, pos)) != std::string::npos) {
+            str.replace(pos, from.size(), to);
+            pos += to.size();
+        }
+        return str;
+    }
+
+    std::string EnumName(const google::protobuf::EnumDescriptor* descriptor) {
+        std::string name = descriptor->name();
+        for(const google::protobuf::Descriptor* outer = descriptor->containing_type(); outer != nullptr; outer = outer->containing_type()) {
+            name = outer->name() + "_" + name;
+        }
+        return name;
+    }
+
+    const char* const kCodecMethods =
+        "        virtual bool HasColumn(const ::google::protobuf::Message& msg, int column) const;\n"
+        "        virtual void AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const;\n"
+        "        virtual void AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const;\n"
+        "        virtual bool SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const;\n";
+}
+
+std::string MysqlCodecWriter::BaseName() const {
+    return StripProto(mFile->name());
+}
+
+std::string MysqlCodecWriter::HeaderName() const {
+    return BaseName() + ".mysql.h";
+}
+
+std::string MysqlCodecWriter::SourceName() const {
+    return BaseName() + ".mysql.cc";
+}
+
+std::string MysqlCodecWriter::Namespace() const {
+    return mFile->package().empty() ? "" : "::" + Replace(mFile->package(), ".", "::");
+}
+
+std::string MysqlCodecWriter::QualifiedName(const google::protobuf::Descriptor* descriptor) const {
+    return Namespace() + "::" + ClassName(descriptor);
+}
+
+bool MysqlCodecWriter::IsTable(const google::protobuf::Descriptor* descriptor) {
+    if(descriptor->field_count() == 0) return false;
+    for(int i = 0; i != descriptor->field_count(); ++i) {
+        if(descriptor->field(i)->is_repeated()) return false;
+    }
+    return true;
+}
+
+std::string MysqlCodecWriter::ClassName(const google::protobuf::Descriptor* descriptor) {
+    std::string name = descriptor->name();
+    for(const google::protobuf::Descriptor* outer = descriptor->containing_type(); outer != nullptr; outer = outer->containing_type()) {
+        name = outer->name() + "_" + name;
+    }
+    return name;
+}
+
+std::string MysqlCodecWriter::CodecName(const google::protobuf::Descriptor* descriptor) {
+    return ClassName(descriptor) + "MysqlCodec";
+}
+
+std::string MysqlCodecWriter::FieldName(const google::protobuf::FieldDescriptor* field) {
+    std::string name = field->name();
+    for(std::size_t i = 0; i != name.size(); ++i) {
+        name[i] = tolower(static_cast<unsigned char>(name[i]));
+    }
+    for(std::size_t i = 0; i != sizeof(kKeywords) / sizeof(kKeywords[0]); ++i) {
+        if(name == kKeywords[i]) {
+            name += '_';
+            break;
+        }
+    }
+    return name;
+}
+
+// same rule as the protobuf cpp generator uses for oneof case constants
+std::string MysqlCodecWriter::CamelName(const std::string& name) {
+    std::string result;
+    bool capitalize = true;
+    for(std::size_t i = 0; i != name.size(); ++i) {
+        char c = name[i];
+        if(islower(static_cast<unsigned char>(c))) {
+            result += capitalize ? static_cast<char>(toupper(static_cast<unsigned char>(c))) : c;
+            capitalize = false;
+        } else if(isupper(static_cast<unsigned char>(c))) {
+            result += c;
+            capitalize = false;
+        } else if(isdigit(static_cast<unsigned char>(c))) {
+            result += c;
+            capitalize = true;
+        } else {
+            capitalize = true;
+        }
+    }
+    return result;
+}
+
+std::string MysqlCodecWriter::HasExpression(const google::protobuf::FieldDescriptor* field) const {
+    const std::string name = FieldName(field);
+#if GOOGLE_PROTOBUF_VERSION >= 3012000
+    // a proto3 optional field sits in a synthetic oneof that has no case accessor, it has has_xxx() instead
+    const google::protobuf::OneofDescriptor* oneof = field->real_containing_oneof();
+    const bool presence = field->has_presence();
+#else
+    const google::protobuf::OneofDescriptor* oneof = field->containing_oneof();
+    const bool presence = mFile->syntax() != google::protobuf::FileDescriptor::SYNTAX_PROTO3
+                          || field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE;
+#endif
+    if(oneof != nullptr) {
+        return "m." + oneof->name() + "_case() == "
+            + QualifiedName(field->containing_type()) + "::k" + CamelName(field->name());
+    }
+    if(presence) {
+        return "m.has_" + name + "()";
+    }
+    // proto3 scalars have no presence, a column is set when it differs from the default like HasField reports
+    switch (field->cpp_type()) {
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            return "m." + name + "()";
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+            return "!m." + name + "().empty()";
+        default:
+            return "m." + name + "() != 0";
+    }
+}
+
+std::string MysqlCodecWriter::AppendStatement(const google::protobuf::FieldDescriptor* field) {
+    const std::string value = "m." + FieldName(field) + "()";
+    switch (field->cpp_type()) {
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+        case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+            return "builder.AppendInt32(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+            return "builder.AppendInt64(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+            return "builder.AppendUInt32(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+            return "builder.AppendUInt64(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+            return "builder.AppendDouble(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+            return "builder.AppendFloat(" + value + ");";
+        case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+            return "builder.Append(" + value + " ? '1' : '0');";
+        case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
+            return "builder.AppendQuoted(" + value + ".data(), " + value + ".length());";
+        case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
+            return "builder.AppendMessage(" + value + ");";
+        default:
+            return "";
+    }
+}
+
+void MysqlCodecWriter::WriteHasColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const {
+    out += "bool " + CodecName(descriptor) + "::HasColumn(const ::google::protobuf::Message& msg, int column) const {\n";
+    out += "    const " + QualifiedName(descriptor) + "& m = static_cast<const " + QualifiedName(descriptor) + "&>(msg);\n";
+    out += "    switch (column) {\n";
+    for(int i = 0; i != descriptor->field_count(); ++i) {
+        out += "        case " + std::to_string(i) + ":\n";
+        out += "            return " + HasExpression(descriptor->field(i)) + ";\n";
+    }
+    out += "        default:\n";
+    out += "            return false;\n";
+    out += "    }\n";
+    out += "}\n\n";
+}
+
+void MysqlCodecWriter::WriteAppendColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const {
+    out += "void " + CodecName(descriptor) + "::AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const {\n";
+    out += "    const " + QualifiedName(descriptor) + "& m = static_cast<const " + QualifiedName(descriptor) + "&>(msg);\n";
+    out += "    switch (column) {\n";
+    for(int i = 0; i != descriptor->field_count(); ++i) {
+        out += "        case " + std::to_string(i) + ":\n";
+        out += "            " + AppendStatement(descriptor->field(i)) + "\n";
+        out += "            break;\n";
+    }
+    out += "        default:\n";
+    out += "            break;\n";
+    out += "    }\n";
+    out += "}\n\n";
+}
+
+void MysqlCodecWriter::WriteAppendRow(const google::protobuf::Descriptor* descriptor, std::string& out) const {
+    out += "void " + CodecName(descriptor) + "::AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const {\n";
+    out += "    const " + QualifiedName(descriptor) + "& m = static_cast<const " + QualifiedName(descriptor) + "&>(msg);\n";
+    out += "    builder.Append('(');\n";
+    for(int i = 0; i != descriptor->field_count(); ++i) {
+        if(i != 0) {
+            out += "    builder.Append(\", \");\n";
+        }
+        out += "    " + AppendStatement(descriptor->field(i)) + "\n";
+    }
+    out += "    builder.Append(')');\n";
+    out += "}\n\n";
+}
+
+void MysqlCodecWriter::WriteSetColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const {
+    out += "bool " + CodecName(descriptor) + "::SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const {\n";
+    out += "    if(data == nullptr) return column >= 0 && column < " + std::to_string(descriptor->field_count()) + ";\n";
+    out += "    " + QualifiedName(descriptor) + "& m = static_cast<" + QualifiedName(descriptor) + "&>(msg);\n";
+    out += "    switch (column) {\n";
+    for(int i = 0; i != descriptor->field_count(); ++i) {
+        const google::protobuf::FieldDescriptor* field = descriptor->field(i);
+        const std::string name = FieldName(field);
+        std::string type, parse, value = "value";
+        switch (field->cpp_type()) {
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+                type = "int32_t", parse = "ParseInt32";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+                type = "int64_t", parse = "ParseInt64";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+                type = "uint32_t", parse = "ParseUInt32";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+                type = "uint64_t", parse = "ParseUInt64";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+                type = "double", parse = "ParseDouble";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+                type = "float", parse = "ParseFloat";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+                type = "int32_t", parse = "ParseInt32", value = "value != 0";
+                break;
+            case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
+                type = "int32_t", parse = "ParseInt32";
+                value = "static_cast<" + Namespace() + "::" + EnumName(field->enum_type()) + ">(value)";
+                break;
+            default:
+                break;
+        }
+        out += "        case " + std::to_string(i) + ":\n";
+        if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_STRING) {
+            out += "            m.set_" + name + "(data, length);\n";
+            out += "            return true;\n";
+        } else if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+            out += "            return m.mutable_" + name + "()->ParseFromArray(data, static_cast<int>(length));\n";
+        } else {
+            out += "            {\n";
+            out += "                " + type + " value;\n";
+            out += "                if(!" + parse + "(data, length, value)) return false;\n";
+            if(field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_ENUM) {
+                out += "                if(!" + Namespace() + "::" + EnumName(field->enum_type()) + "_IsValid(value)) return false;\n";
+            }
+            out += "                m.set_" + name + "(" + value + ");\n";
+            out += "            }\n";
+            out += "            return true;\n";
+        }
+    }
+    out += "        default:\n";
+    out += "            return false;\n";
+    out += "    }\n";
+    out += "}\n\n";
+}
+
+void MysqlCodecWriter::OpenNamespace(std::string& out, std::string& closing) const {
+    if(mFile->package().empty()) return;
+    const std::string package = mFile->package() + ".";
+    std::size_t start = 0, dot;
+    while((dot = package.find('.', start)) != std::string::npos) {
+        out += "namespace " + package.substr(start, dot - start) + " {\n";
+        closing = "}  // namespace " + package.substr(start, dot - start) + "\n" + closing;
+        start = dot + 1;
+    }
+    out += "\n";
+}
+
+std::string MysqlCodecWriter::Header() const {
+    std::string guard = "PROTOBUF_MYSQL_" + BaseName() + "_INCLUDED";
+    for(std::size_t i = 0; i != guard.size(); ++i) {
+        if(!isalnum(static_cast<unsigned char>(guard[i]))) {
+            guard[i] = '_';
+        }
+    }
+
+    std::string out;
+    out += "// Generated by protoc-gen-mysql.  DO NOT EDIT!\n";
+    out += "// source: " + mFile->name() + "\n\n";
+    out += "#ifndef " + guard + "\n";
+    out += "#define " + guard + "\n\n";
+    out += "#include \"" + BaseName() + ".pb.h\"\n";
+    out += "#include <soul/protobuf-mysql/MysqlCodec.h>\n\n";
+    std::string closing;
+    OpenNamespace(out, closing);
+    for(int i = 0; i != mFile->message_type_count(); ++i) {
+        const google::protobuf::Descriptor* descriptor = mFile->message_type(i);
+        if(!IsTable(descriptor)) continue;
+        out += "// columns:";
+        for(int loop = 0; loop != descriptor->field_count(); ++loop) {
+            const google::protobuf::FieldDescriptor* field = descriptor->field(loop);
+            out += (loop == 0 ? " " : ", ") + field->name();
+            if(field->options().GetExtension(primarykey)) {
+                out += " (primarykey)";
+            }
+            if(field->options().GetExtension(updatekey)) {
+                out += " (updatekey)";
+            }
+        }
+        out += "\n";
+        out += "class " + CodecName(descriptor) + " : public ::soul::MysqlCodec {\n";
+        out += "    public:\n";
+        out += kCodecMethods;
+        out += "        static const " + CodecName(descriptor) + "& Instance();\n";
+        out += "};\n\n";
+    }
+    out += closing;
+    if(!closing.empty()) {
+        out += "\n";
+    }
+    out += "#endif  // " + guard + "\n";
+    return out;
+}
+
+std::string MysqlCodecWriter::Source() const {
+    std::string out;
+    out += "// Generated by protoc-gen-mysql.  DO NOT EDIT!\n";
+    out += "// source: " + mFile->name() + "\n\n";
+    out += "#include \"" + HeaderName() + "\"\n";
+    out += "#include <soul/protobuf-mysql/MysqlSqlBuilder.h>\n\n";
+    std::string closing, registrations;
+    OpenNamespace(out, closing);
+    for(int i = 0; i != mFile->message_type_count(); ++i) {
+        const google::protobuf::Descriptor* descriptor = mFile->message_type(i);
+        if(!IsTable(descriptor)) continue;
+        WriteHasColumn(descriptor, out);
+        WriteAppendColumn(descriptor, out);
+        WriteAppendRow(descriptor, out);
+        WriteSetColumn(descriptor, out);
+        out += "const " + CodecName(descriptor) + "& " + CodecName(descriptor) + "::Instance() {\n";
+        out += "    static const " + CodecName(descriptor) + " codec;\n";
+        out += "    return codec;\n";
+        out += "}\n\n";
+        registrations += "            ::soul::MysqlCodec::Register(" + QualifiedName(descriptor) + "::descriptor(), &"
+            + CodecName(descriptor) + "::Instance());\n";
+    }
+    if(!registrations.empty()) {
+        out += "namespace {\n";
+        out += "    struct MysqlCodecRegistrar {\n";
+        out += "        MysqlCodecRegistrar() {\n";
+        out += registrations;
+        out += "        }\n";
+        out += "    } registrar;\n";
+        out += "}\n\n";
+    }
+    out += closing;
+    return out;
+}
@@ -0,0 +1,47 @@
+#ifndef MYSQLCODECWRITER_H
+#define MYSQLCODECWRITER_H
+
+#include <string>
+
+namespace google {
+    namespace protobuf {
+        class FileDescriptor;
+        class Descriptor;
+        class FieldDescriptor;
+    }
+}
+
+namespace soul {
+    // writes <name>.mysql.h and <name>.mysql.cc holding one MysqlCodec per table message of a proto file
+    class MysqlCodecWriter {
+        private:
+            const google::protobuf::FileDescriptor* mFile;
+        public:
+            explicit MysqlCodecWriter(const google::protobuf::FileDescriptor* file) : mFile(file) {}
+
+            std::string HeaderName() const;
+            std::string SourceName() const;
+            std::string Header() const;
+            std::string Source() const;
+
+            // messages mapped to one row: at least one field and no repeated field
+            static bool IsTable(const google::protobuf::Descriptor* descriptor);
+        private:
+            std::string BaseName() const;
+            std::string Namespace() const;
+            std::string QualifiedName(const google::protobuf::Descriptor* descriptor) const;
+            void OpenNamespace(std::string& out, std::string& closing) const;
+            void WriteHasColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const;
+            void WriteAppendColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const;
+            void WriteAppendRow(const google::protobuf::Descriptor* descriptor, std::string& out) const;
+            void WriteSetColumn(const google::protobuf::Descriptor* descriptor, std::string& out) const;
+            std::string HasExpression(const google::protobuf::FieldDescriptor* field) const;
+            static std::string AppendStatement(const google::protobuf::FieldDescriptor* field);
+            static std::string CodecName(const google::protobuf::Descriptor* descriptor);
+            static std::string ClassName(const google::protobuf::Descriptor* descriptor);
+            static std::string FieldName(const google::protobuf::FieldDescriptor* field);
+            static std::string CamelName(const std::string& name);
+    };
+}
+
+#endif /*MYSQLCODECWRITER_H*/
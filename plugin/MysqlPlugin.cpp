@@ -0,0 +1,46 @@
+#include "MysqlCodecWriter.h"
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/compiler/plugin.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <google/protobuf/descriptor.h>
+#include <memory>
+
+using namespace soul;
+
+namespace {
+    bool WriteFile(google::protobuf::compiler::GeneratorContext* context, const std::string& name, const std::string& content) {
+        std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> output(context->Open(name));
+        google::protobuf::io::CodedOutputStream stream(output.get());
+        stream.WriteString(content);
+        return !stream.HadError();
+    }
+
+    class MysqlCodeGenerator : public google::protobuf::compiler::CodeGenerator {
+        public:
+            virtual bool Generate(const google::protobuf::FileDescriptor* file,
+                                  const std::string& parameter,
+                                  google::protobuf::compiler::GeneratorContext* context,
+                                  std::string* error) const {
+                MysqlCodecWriter writer(file);
+                if(!WriteFile(context, writer.HeaderName(), writer.Header())
+                        || !WriteFile(context, writer.SourceName(), writer.Source())) {
+                    *error = "write " + writer.HeaderName() + " failed";
+                    return false;
+                }
+                return true;
+            }
+#if GOOGLE_PROTOBUF_VERSION >= 3012000
+            // proto3 optional fields are tested with has_xxx(), see MysqlCodecWriter::HasExpression
+            virtual uint64_t GetSupportedFeatures() const {
+                return FEATURE_PROTO3_OPTIONAL;
+            }
+#endif
+    };
+}
+
+// protoc -I=. --plugin=protoc-gen-mysql --mysql_out=. xxx.proto
+int main(int argc, char *argv[]) {
+    MysqlCodeGenerator generator;
+    return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+}
@@ -0,0 +1,142 @@
+#include <soul/protobuf-mysql/MysqlFormat.h>
+#include <boost/lexical_cast.hpp>
+#include <mysql/mysql.h>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace soul;
+
+const int count = 1000000;
+
+template<typename F>
+double Measure(F f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+void Report(const std::string& name, double before, double after, std::size_t mismatch) {
+    std::cout << name << ": lexical_cast " << before << " ms, MysqlFormat " << after
+              << " ms, speedup " << before / after << "x, mismatch " << mismatch << std::endl;
+}
+
+void BenchmarkInt64(const std::vector<int64_t>& values) {
+    std::size_t before = 0, after = 0;
+    double lexical = Measure([&]() {
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            before += boost::lexical_cast<std::string>(values[i]).length();
+        }
+    });
+    double format = Measure([&]() {
+        std::string buffer;
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+            buffer.assign(tmp, MysqlFormat::FormatInt64(values[i], tmp));
+            after += buffer.length();
+        }
+    });
+    Report("int64", lexical, format, before != after);
+}
+
+void BenchmarkUInt32(const std::vector<int64_t>& values) {
+    std::size_t before = 0, after = 0;
+    double lexical = Measure([&]() {
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            before += boost::lexical_cast<std::string>(static_cast<uint32_t>(values[i])).length();
+        }
+    });
+    double format = Measure([&]() {
+        std::string buffer;
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+            buffer.assign(tmp, MysqlFormat::FormatUInt32(static_cast<uint32_t>(values[i]), tmp));
+            after += buffer.length();
+        }
+    });
+    Report("uint32", lexical, format, before != after);
+}
+
+void BenchmarkDouble(const std::vector<double>& values) {
+    std::size_t before = 0, after = 0, mismatch = 0;
+    double lexical = Measure([&]() {
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            before += boost::lexical_cast<std::string>(values[i]).length();
+        }
+    });
+    double format = Measure([&]() {
+        std::string buffer;
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+            buffer.assign(tmp, MysqlFormat::FormatDouble(values[i], tmp));
+            after += buffer.length();
+        }
+    });
+    for(std::size_t i = 0; i != values.size(); ++i) {
+        char tmp[MysqlFormat::MAX_NUMBER_LENGTH];
+        tmp[MysqlFormat::FormatDouble(values[i], tmp)] = '\0';
+        if(strtod(tmp, nullptr) != values[i]) {
+            ++mismatch;
+        }
+    }
+    Report("double", lexical, format, mismatch);
+    std::cout << "double: average length " << double(before) / values.size() << " -> " << double(after) / values.size() << std::endl;
+}
+
+void BenchmarkEscape(const std::vector<std::string>& values) {
+    std::size_t mismatch = 0;
+    std::vector<char> before, after;
+    double escape = Measure([&]() {
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            before.resize(values[i].length() * 2 + 1);
+            mysql_escape_string(&before[0], values[i].data(), values[i].length());
+        }
+    });
+    double format = Measure([&]() {
+        for(std::size_t i = 0; i != values.size(); ++i) {
+            after.resize(values[i].length() * 2 + 1);
+            MysqlFormat::EscapeString(values[i].data(), values[i].length(), &after[0]);
+        }
+    });
+    for(std::size_t i = 0; i != values.size(); ++i) {
+        before.resize(values[i].length() * 2 + 1);
+        after.resize(values[i].length() * 2 + 1);
+        std::size_t len = mysql_escape_string(&before[0], values[i].data(), values[i].length());
+        if(MysqlFormat::EscapeString(values[i].data(), values[i].length(), &after[0]) != len
+                || memcmp(&before[0], &after[0], len) != 0) {
+            ++mismatch;
+        }
+    }
+    std::cout << "escape: mysql_escape_string " << escape << " ms, MysqlFormat " << format
+              << " ms, speedup " << escape / format << "x, mismatch " << mismatch << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    std::mt19937_64 random(20170101);
+    std::vector<int64_t> ints(count);
+    std::vector<double> doubles(count);
+    for(int i = 0; i != count; ++i) {
+        ints[i] = static_cast<int64_t>(random()) >> (random() % 64);
+        doubles[i] = (i % 2) ? static_cast<double>(random() % 100000) / 100 : std::ldexp(static_cast<double>(random()), -static_cast<int>(random() % 80));
+    }
+
+    BenchmarkInt64(ints);
+    BenchmarkUInt32(ints);
+    BenchmarkDouble(doubles);
+
+    std::vector<std::string> strings(count / 10);
+    for(std::size_t i = 0; i != strings.size(); ++i) {
+        strings[i].resize(random() % 1024);
+        for(std::size_t j = 0; j != strings[i].size(); ++j) {
+            strings[i][j] = (random() % 64 == 0) ? "\0\n\r\\'\"\x1a"[random() % 7] : static_cast<char>('a' + random() % 26);
+        }
+    }
+    BenchmarkEscape(strings);
+    return 0;
+}
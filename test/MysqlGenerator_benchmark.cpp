@@ -0,0 +1,165 @@
+#include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlRowDecoder.h>
+#include "proto/test.pb.h"
+#include "proto/test.mysql.h"
+#include <soul/Log.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace soul;
+
+const int count = 200000;
+
+template<typename F>
+double Measure(F f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+void Report(const std::string& name, double before, double after, std::size_t mismatch) {
+    std::cout << name << ": reflection " << before << " ms, generated " << after
+              << " ms, speedup " << before / after << "x, mismatch " << mismatch << std::endl;
+}
+
+void FillTest(table_test& test, int i) {
+    test.set_keyid(i);
+    test.set_field1(i * 7);
+    test.set_field2(i * 13);
+    test.mutable_field3()->set_filedint(-i);
+    test.mutable_field3()->set_fieldstring("name'" + std::to_string(i));
+}
+
+template<typename F>
+void BenchmarkGenerate(const std::string& name, int loop, F generate) {
+    MysqlGenerator reflection("dbname", "tablename");
+    reflection.SetGeneratedCodec(false);
+    MysqlGenerator generated("dbname", "tablename");
+    std::size_t before = 0, after = 0, mismatch = 0;
+    double reflectionTime = Measure([&]() {
+        for(int i = 0; i != loop; ++i) {
+            before += generate(reflection, i).length();
+        }
+    });
+    double generatedTime = Measure([&]() {
+        for(int i = 0; i != loop; ++i) {
+            after += generate(generated, i).length();
+        }
+    });
+    for(int i = 0; i < loop; i += 97) {
+        if(generate(reflection, i) != generate(generated, i)) {
+            ++mismatch;
+        }
+    }
+    Report(name, reflectionTime, generatedTime, mismatch + (before != after));
+}
+
+void BenchmarkDecode() {
+    const char* row[] = {"123456", "7", "4294967295", ""};
+    unsigned long lengths[] = {6, 1, 10, 0};
+    table_field_message sub;
+    sub.set_filedint(42);
+    sub.set_fieldstring("decoded");
+    std::string serialized = sub.SerializeAsString();
+    row[3] = serialized.data();
+    lengths[3] = serialized.length();
+
+    const MysqlCodec& reflection = MysqlCodec::GetReflectionCodec(table_test::descriptor());
+    const MysqlCodec& generated = table_testMysqlCodec::Instance();
+    table_test before, after;
+    double reflectionTime = Measure([&]() {
+        for(int i = 0; i != count; ++i) {
+            for(int column = 0; column != 4; ++column) {
+                reflection.SetColumn(before, column, row[column], lengths[column]);
+            }
+        }
+    });
+    double generatedTime = Measure([&]() {
+        for(int i = 0; i != count; ++i) {
+            for(int column = 0; column != 4; ++column) {
+                generated.SetColumn(after, column, row[column], lengths[column]);
+            }
+        }
+    });
+    Report("decode", reflectionTime, generatedTime, before.SerializeAsString() != after.SerializeAsString());
+}
+
+// result columns looked up by name for every cell against names resolved once per result set
+void BenchmarkRowDecode() {
+    const char* names[] = {"keyid", "field1", "field2", "field3"};
+    const char* row[] = {"123456", "7", "4294967295", ""};
+    unsigned long lengths[] = {6, 1, 10, 0};
+    table_field_message sub;
+    sub.set_filedint(42);
+    sub.set_fieldstring("decoded");
+    std::string serialized = sub.SerializeAsString();
+    row[3] = serialized.data();
+    lengths[3] = serialized.length();
+    MYSQL_FIELD fields[4];
+    std::memset(fields, 0, sizeof(fields));
+    for(int column = 0; column != 4; ++column) {
+        fields[column].name = const_cast<char*>(names[column]);
+    }
+
+    MysqlRowDecoder decoder;
+    table_test before, after;
+    double lookupTime = Measure([&]() {
+        for(int i = 0; i != count; ++i) {
+            for(int column = 0; column != 4; ++column) {
+                MysqlGenerator::ApplySelectResult(before, row[column], lengths[column], &fields[column]);
+            }
+        }
+    });
+    MysqlDecodeStatus status;
+    decoder.Reset(MysqlCodec::GetReflectionCodec(table_test::descriptor()), table_test::descriptor(), fields, 4);
+    double reflectionTime = Measure([&]() {
+        for(int i = 0; i != count; ++i) {
+            decoder.Decode(const_cast<char**>(row), lengths, after, status);
+        }
+    });
+    std::size_t mismatch = before.SerializeAsString() != after.SerializeAsString();
+    after.Clear();
+    decoder.Reset(table_testMysqlCodec::Instance(), table_test::descriptor(), fields, 4);
+    double generatedTime = Measure([&]() {
+        for(int i = 0; i != count; ++i) {
+            decoder.Decode(const_cast<char**>(row), lengths, after, status);
+        }
+    });
+    mismatch += before.SerializeAsString() != after.SerializeAsString();
+    std::cout << "row decode: lookup per cell " << lookupTime << " ms, resolved reflection " << reflectionTime
+              << " ms, resolved generated " << generatedTime << " ms, speedup " << lookupTime / generatedTime
+              << "x, mismatch " << mismatch << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    START_ASYNC_LOG();
+    std::vector<table_test> tests(count);
+    for(int i = 0; i != count; ++i) {
+        FillTest(tests[i], i);
+    }
+    table_test_repeated repeated;
+    for(int i = 0; i != 5000; ++i) {
+        FillTest(*repeated.add_fields(), i);
+    }
+
+    BenchmarkGenerate("insert", count, [&](const MysqlGenerator& generator, int i) {
+        return generator.GenerateSqlInsert(tests[i]);
+    });
+    BenchmarkGenerate("update", count, [&](const MysqlGenerator& generator, int i) {
+        return generator.GenerateSqlUpdate(tests[i])[0];
+    });
+    BenchmarkGenerate("update on insert", count, [&](const MysqlGenerator& generator, int i) {
+        return generator.GenerateSqlUpdateOnInsert(tests[i]);
+    });
+    BenchmarkGenerate("insert 5000 rows", 40, [&](const MysqlGenerator& generator, int i) {
+        return generator.GenerateSqlInsert(repeated);
+    });
+    BenchmarkDecode();
+    BenchmarkRowDecode();
+    return 0;
+}
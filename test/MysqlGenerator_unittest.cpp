@@ -1,6 +1,11 @@
 #include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlPlan.h>
+#include <soul/protobuf-mysql/MysqlCodec.h>
+#include <soul/protobuf-mysql/MysqlTable.h>
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
 #include "./proto/test.pb.h"
 #include <soul/Log.h>
+#include <clocale>
 #include <iostream>
 
 using namespace soul;
@@ -35,6 +40,17 @@ void TestCaseInsertSingleAllField() {
     g.GenerateSqlInsert(t);
 }
 
+void TestCaseInsertSingleHexMessage() {
+    table_test t;
+    t.set_keyid(1000);
+    table_field_message* m = t.mutable_field3();
+    m->set_filedint(-1);
+    m->set_fieldstring(std::string("with\0nul", 8));
+    MysqlGenerator g(database, table);
+    g.SetMessageEncoding(MysqlGenerator::MESSAGE_HEX);
+    g.GenerateSqlInsert(t);
+}
+
 void TestCaseInsertRepeatedNothing() {
     table_test_repeated t;
     MysqlGenerator g(database, table);
@@ -92,6 +108,38 @@ void TestCaseInsertRepeatedMultiAllField() {
     g.GenerateSqlInsert(t);
 }
 
+void TestCaseInsertRepeatedChunked() {
+    table_test_repeated t;
+    for(int i = 0; i != 10; ++i) {
+        table_test* field = t.add_fields();
+        field->set_keyid(i);
+        field->set_field1(i * 10);
+        field->set_field2(i * 100);
+    }
+    MysqlGenerator g(database, table);
+    MysqlSqlContext context;
+    context.maxPacketSize = 200;
+    int chunks = 0;
+    int ret = g.GenerateSqlInsert(t, context, [&chunks](const std::string& sql) {
+        ++chunks;
+        return 0;
+    });
+    std::cout << ret << ", " << chunks << std::endl;
+
+    // a sink generating another chunked insert on the same thread leaves the outer rows intact
+    table_test_repeated other(t);
+    for(int i = 0; i != other.fields_size(); ++i) {
+        other.mutable_fields(i)->set_keyid(100 + i);
+    }
+    std::string rows;
+    ret = g.GenerateSqlInsert(t, context, [&g, &other, &context, &rows](const std::string& sql) {
+        rows += sql.substr(sql.find(" values ") + 8) + ", ";
+        return g.GenerateSqlInsert(other, context, [](const std::string&) { return 0; });
+    });
+    std::string whole = g.GenerateSqlInsert(t);
+    std::cout << ret << ", " << (rows == whole.substr(whole.find(" values ") + 8) + ", ") << std::endl;
+}
+
 void TestCaseSelectSingleAllField() {
     table_test t;
     MysqlGenerator g(database, table);
@@ -132,6 +180,62 @@ void TestCaseSelectMultiNothing() {
     g.GenerateSqlSelect(t);
 }
 
+void PrintMapping(const MysqlSelectMapping& mapping) {
+    for(std::size_t i = 0; i != mapping.rowRequest.size(); ++i) {
+        std::cout << mapping.rowRequest[i] << " ";
+    }
+    std::cout << "missing:";
+    for(std::size_t i = 0; i != mapping.missing.size(); ++i) {
+        std::cout << " " << mapping.missing[i];
+    }
+    std::cout << std::endl;
+}
+
+void TestCaseSelectMultiKeys() {
+    table_test_repeated r;
+    r.add_fields()->set_keyid(1);
+    r.add_fields()->set_keyid(2);
+    table_test* t = r.add_fields();
+    t->set_field1(3);
+    t->set_field2(4);
+    r.add_fields()->set_keyid(5);
+    MysqlGenerator g(database, table);
+    g.GenerateSqlSelect(r);
+
+    table_test_repeated result;
+    for(int i = 0; i != 3; ++i) {
+        table_test* row = result.add_fields();
+        row->set_keyid(i == 0 ? 2 : i == 1 ? 7 : 1);
+        row->set_field1(i == 1 ? 3 : 0);
+        row->set_field2(i == 1 ? 4 : 0);
+    }
+    MysqlSelectMapping mapping;
+    g.MapSelectResult(r, result, mapping);
+    PrintMapping(mapping);
+}
+
+void TestCaseSelectMultiDuplicateKeys() {
+    // the same key twice and a row satisfying elements of two groups
+    table_test_repeated r;
+    r.add_fields()->set_keyid(2);
+    r.add_fields()->set_keyid(2);
+    table_test* t = r.add_fields();
+    t->set_field1(3);
+    t->set_field2(4);
+    r.add_fields()->set_keyid(7);
+    MysqlGenerator g(database, table);
+
+    table_test_repeated result;
+    table_test* row = result.add_fields();
+    row->set_keyid(7);
+    row->set_field1(3);
+    row->set_field2(4);
+    result.add_fields()->set_keyid(2);
+    MysqlSelectMapping mapping;
+    g.MapSelectResult(r, result, mapping);
+    PrintMapping(mapping);
+}
+
 void TestCaseUpdateSingleNothing() {
     table_test t;
     MysqlGenerator g(database, table);
@@ -190,6 +294,25 @@ void TestCaseUpdateMulti() {
     g.GenerateSqlUpdate(t);
 }
 
+void TestCaseUpdateMultiBatch() {
+    table_test_repeated t;
+    for(int i = 0; i != 4; ++i) {
+        table_test* field = t.add_fields();
+        field->set_keyid(i);
+        field->set_field1(i % 3);
+        if(i % 2) {
+            field->set_field2(i * 10);
+        }
+    }
+    MysqlGenerator g(database, table);
+    g.SetUpdateMode(MysqlGenerator::UPDATE_BATCH);
+    g.GenerateSqlUpdate(t);
+
+    MysqlSqlContext context;
+    context.maxPacketSize = 200;
+    g.GenerateSqlUpdate(t, context);
+}
+
 void TestCaseDeleteNothing() {
     table_test t;
     MysqlGenerator g(database, table);
@@ -212,6 +335,24 @@ void TestCaseDeleteWithWhere() {
     g.GenerateSqlDelete(t);
 }
 
+void TestCaseDeleteMulti() {
+    table_test_repeated t;
+    for(int i = 0; i != 5; ++i) {
+        table_test* field = t.add_fields();
+        field->set_keyid(i);
+        if(i % 2) {
+            field->set_field1(i * 10);
+        }
+    }
+    t.add_fields();
+    MysqlGenerator g(database, table);
+    g.GenerateSqlDelete(t);
+
+    MysqlSqlContext context;
+    context.maxPacketSize = 48;
+    g.GenerateSqlDelete(t, context);
+}
+
 void TestUpdateOnInsert() {
     table_test t;
     t.set_keyid(3);
@@ -221,22 +362,158 @@ void TestUpdateOnInsert() {
     g.GenerateSqlUpdateOnInsert(t);
 }
 
+void TestUpdateOnInsertMulti() {
+    table_test_repeated r;
+    for(int i = 1; i != 6; ++i) {
+        table_test* t = r.add_fields();
+        t->set_keyid(i);
+        t->set_field1(i * 10);
+        if(i % 2) {
+            t->set_field2(i * 100);
+        }
+    }
+    // keyid 1 again with other fields, must run after the first one
+    table_test* t = r.add_fields();
+    t->set_keyid(1);
+    t->set_field1(11);
+
+    MysqlGenerator g(database, table);
+    MysqlSqlContext context;
+    context.maxPacketSize = 170;
+    g.GenerateSqlUpdateOnInsert(r, context, [](const std::string& sql) {
+        std::cout << sql << std::endl;
+        return 0;
+    });
+    r.mutable_fields()->RemoveLast();
+    std::cout << g.GenerateSqlUpdateOnInsert(r).empty() << std::endl;
+}
+
 void TestCaseTrim(std::string str, int expect) {
     MysqlGenerator::TrimString(str);
     std::cout << str.length() << ", " << expect << ", " << str << std::endl;
 }
 
+void TestCasePlanCache() {
+    const MysqlTarget* target = MysqlPlanCache::GetTarget(database, table);
+    const MysqlPlan* plan = MysqlPlanCache::GetPlan(table_test::descriptor(), target);
+    const MysqlPlan* repeatedPlan = MysqlPlanCache::GetPlan(table_test_repeated::descriptor(), target);
+    std::cout << (target == MysqlPlanCache::GetTarget(database, table)) << ", "
+              << (plan == MysqlPlanCache::GetPlan(table_test::descriptor(), target)) << ", "
+              << (repeatedPlan->element == plan) << ", "
+              << plan->columns.size() << ", " << plan->allColumns << std::endl;
+}
+
+void TestCaseGeneratedCodec() {
+    table_test_repeated r;
+    for(int i = 0; i != 3; ++i) {
+        table_test* t = r.add_fields();
+        t->set_keyid(i);
+        t->set_field1(i * 10);
+        t->mutable_field3()->set_fieldstring("it's");
+    }
+    MysqlGenerator reflection(database, table);
+    reflection.SetGeneratedCodec(false);
+    MysqlGenerator generated(database, table);
+    std::cout << (MysqlCodec::Find(table_test::descriptor()) != nullptr) << ", "
+              << (reflection.GenerateSqlInsert(r) == generated.GenerateSqlInsert(r)) << ", "
+              << (reflection.GenerateSqlUpdate(r) == generated.GenerateSqlUpdate(r)) << std::endl;
+}
+
+void TestCaseParseInt32(const std::string& cell, bool expect) {
+    int32_t value = 0;
+    bool ok = MysqlCodec::ParseInt32(cell.data(), cell.length(), value);
+    std::cout << ok << ", " << expect << ", " << value << std::endl;
+}
+
+void TestCaseParseDouble(const std::string& cell, bool expect) {
+    double value = 0;
+    bool ok = MysqlCodec::ParseDouble(cell.data(), cell.length(), value);
+    std::cout << ok << ", " << expect << ", " << value << std::endl;
+}
+
+void TestCaseDecodeCell() {
+    const MysqlCodec& reflection = MysqlCodec::GetReflectionCodec(table_test::descriptor());
+    const MysqlCodec& generated = MysqlCodec::Get(table_test::descriptor());
+    table_field_message sub;
+    sub.set_filedint(7);
+    sub.set_fieldstring(std::string("a\0b", 3));
+    const std::string blob = sub.SerializeAsString();
+    table_test before, after;
+    // NULL leaves keyid unset, the blob holds a NUL, field2 does not fit uint32
+    std::cout << reflection.SetColumn(before, 0, nullptr, 0) << generated.SetColumn(after, 0, nullptr, 0) << ", "
+              << reflection.SetColumn(before, 3, blob.data(), blob.length()) << generated.SetColumn(after, 3, blob.data(), blob.length()) << ", "
+              << reflection.SetColumn(before, 2, "4294967296", 10) << generated.SetColumn(after, 2, "4294967296", 10) << ", "
+              << before.has_keyid() << after.has_keyid() << ", "
+              << (before.field3().fieldstring().length() == 3) << (before.SerializeAsString() == after.SerializeAsString()) << std::endl;
+}
+
+void TestCaseTable() {
+    static const MysqlTable<table_test> testTable(database, table);
+    table_test t;
+    t.set_keyid(3);
+    t.set_field1(0);
+    t.set_field2(1);
+    testTable.GenerateSqlInsert(t);
+    testTable.GenerateSqlUpsert(t);
+    testTable.GenerateSqlUpdate(t);
+}
+
+void TestCaseReuseBuffer() {
+    MysqlGenerator g(database, table);
+    MysqlSqlContext context;
+    std::string sql;
+    std::size_t capacity = 0;
+    int grows = 0;
+    for(int i = 0; i != 100; ++i) {
+        table_test t;
+        t.set_keyid(i);
+        t.set_field1(i * 2);
+        t.set_field2(i * 3);
+        g.GenerateSqlUpdateOnInsert(t, context, sql);
+        if(sql.capacity() != capacity) {
+            capacity = sql.capacity();
+            ++grows;
+        }
+    }
+    std::cout << sql << std::endl << "buffer grows: " << grows << std::endl;
+}
+
+void TestCaseStatement() {
+    table_test t;
+    t.set_keyid(3);
+    t.set_field1(0);
+    t.set_field2(1);
+    MysqlGenerator g(database, table);
+    uint64_t mask = 0;
+    const MysqlPlan* plan = g.GetRowShape(t, mask);
+    std::string sql;
+    std::vector<int> columns;
+    g.GenerateStatement(MysqlGenerator::STATEMENT_INSERT, *plan, mask, sql, columns);
+    g.GenerateStatement(MysqlGenerator::STATEMENT_UPDATE_ON_INSERT, *plan, mask, sql, columns);
+    g.GenerateStatement(MysqlGenerator::STATEMENT_UPDATE, *plan, mask, sql, columns);
+    g.GenerateStatement(MysqlGenerator::STATEMENT_DELETE, *plan, mask, sql, columns);
+    for(std::size_t i = 0; i != columns.size(); ++i) {
+        std::cout << columns[i] << " ";
+    }
+    std::cout << std::endl;
+
+    table_test_repeated r;
+    std::cout << (g.GetRowShape(r, mask) == nullptr) << std::endl;
+}
+
 int main(int argc, char *argv[]) {
     START_ASYNC_LOG();
 
     //TestCaseInsertNothing();
     //TestCaseInsertSingleSomeField();
     //TestCaseInsertSingleAllField();
+    //TestCaseInsertSingleHexMessage();
     //TestCaseInsertRepeatedNothing();
     //TestCaseInsertRepeatedSomeFiled();
     //TestCaseInsertRepeatedAllField();
     //TestCaseInsertRepeatedMultiSomeField();
     //TestCaseInsertRepeatedMultiAllField();
+    //TestCaseInsertRepeatedChunked();
 
 
     //TestCaseSelectSingleAllField();
@@ -244,6 +521,8 @@ int main(int argc, char *argv[]) {
     //TestCaseSelectSingleWhereCondition();
     //TestCaseSelectMulti();
     //TestCaseSelectMultiNothing();
+    //TestCaseSelectMultiKeys();
+    //TestCaseSelectMultiDuplicateKeys();
 
     //TestCaseUpdateSingleNothing();
     //TestCaseUpdateSingleSomeField();
@@ -252,12 +531,42 @@ int main(int argc, char *argv[]) {
     //TestCaseUpdateMultiNoUpdateKey();
     //TestCaseUpdateMultiWithUpdateKey();
     //TestCaseUpdateMulti();
+    //TestCaseUpdateMultiBatch();
 
     //TestUpdateOnInsert();
+    //TestUpdateOnInsertMulti();
+    //TestCaseTable();
+    //TestCaseReuseBuffer();
+    //TestCaseStatement();
 
     //TestCaseDeleteNothing();
     //TestCaseDelete();
     //TestCaseDeleteWithWhere();
+    //TestCaseDeleteMulti();
+
+    TestCasePlanCache();
+    TestCaseGeneratedCodec();
+    TestCaseDecodeCell();
+
+    TestCaseParseInt32("0", true);
+    TestCaseParseInt32("-2147483648", true);
+    TestCaseParseInt32("2147483647", true);
+    TestCaseParseInt32("2147483648", false);
+    TestCaseParseInt32("-", false);
+    TestCaseParseInt32("", false);
+    TestCaseParseInt32("12a", false);
+    TestCaseParseInt32(std::string("12\0", 3), false);
+
+    // cells always use '.', whatever LC_NUMERIC the process runs with
+    setlocale(LC_NUMERIC, "de_DE.UTF-8");
+    TestCaseParseDouble("1.5", true);
+    TestCaseParseDouble("-2.5e-3", true);
+    TestCaseParseDouble("1e400", false);
+    TestCaseParseDouble("0x1p3", false);
+    TestCaseParseDouble("nan", false);
+    TestCaseParseDouble("inf", false);
+    TestCaseParseDouble("1,5", false);
+    setlocale(LC_NUMERIC, "C");
 
     TestCaseTrim(" ", 0);
     TestCaseTrim("\t", 0);
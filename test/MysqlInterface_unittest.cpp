@@ -1,8 +1,17 @@
 #include <soul/protobuf-mysql/MysqlInterface.h>
 #include <soul/protobuf-mysql/MysqlGenerator.h>
+#include <soul/protobuf-mysql/MysqlTable.h>
+#include <soul/protobuf-mysql/MysqlConnectionPool.h>
+#include <soul/protobuf-mysql/MysqlReactor.h>
+#include <soul/protobuf-mysql/MysqlWorker.h>
+#include <soul/protobuf-mysql/MysqlWriteBehind.h>
+#include <soul/protobuf-mysql/MysqlUpdateCoalescer.h>
 #include "./proto/test.pb.h"
 #include <soul/Log.h>
+#include <google/protobuf/arena.h>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 using namespace soul;
 
@@ -62,6 +71,31 @@ void TestCaseSelectMultiRows(MysqlInterface& interface) {
     LOG_DEBUG << "result: " << ret << ", " << r.ShortDebugString();
 }
 
+void TestCaseSelectArena(MysqlInterface& interface) {
+    google::protobuf::Arena arena;
+    table_test_repeated* r = google::protobuf::Arena::CreateMessage<table_test_repeated>(&arena);
+    r->add_fields()->set_field2(20);
+
+    int ret = interface.ExecuteSqlSelect(MysqlGenerator(database, table), *r);
+    LOG_DEBUG << "result: " << ret << ", rows: " << r->fields_size()
+              << ", on arena: " << (r->fields_size() == 0 || r->fields(0).GetArena() == &arena)
+              << ", arena bytes: " << arena.SpaceUsed();
+}
+
+void TestCaseSelectStream(MysqlInterface& interface) {
+    table_test_repeated r;
+    r.add_fields()->set_field2(20);
+
+    int rows = 0;
+    int ret = interface.ExecuteSqlSelect(MysqlGenerator(database, table), r, 100, [&rows](google::protobuf::Message& batch) {
+        table_test_repeated& fields = static_cast<table_test_repeated&>(batch);
+        rows += fields.fields_size();
+        LOG_DEBUG << "batch: " << fields.ShortDebugString();
+        return 0;
+    });
+    LOG_DEBUG << "result: " << ret << ", rows: " << rows;
+}
+
 void TestCaseUpdateOnInsert(MysqlInterface& interface) {
     table_test t;
     t.set_field1(2);
@@ -96,6 +130,253 @@ void TestCaseDeleteMulti(MysqlInterface& interface) {
     }
 }
 
+void TestCaseMultiStatements(MysqlInterface& interface) {
+    // rows setting different fields update one by one, all statements go out in one round trip
+    table_test_repeated r;
+    for(int i = 0; i != 100; ++i) {
+        table_test* t = r.add_fields();
+        t->set_field1(i);
+        if(i % 2) {
+            t->set_field2(i);
+        } else {
+            t->mutable_field3()->set_fieldstring("multi");
+        }
+    }
+    interface.SetMultiStatements(true);
+    int ret = interface.ExecuteSqlUpdate(MysqlGenerator(database, table), r);
+    LOG_DEBUG << "result: " << ret << ", affected rows: " << interface.AffectedRows() << ", failed statement: " << interface.FailedStatement();
+    interface.SetMultiStatements(false);
+}
+
+void TestCaseTable(MysqlInterface& interface) {
+    static const MysqlTable<table_test> testTable(database, table);
+    table_test t;
+    t.set_keyid(20);
+    t.set_field1(21);
+    t.set_field2(22);
+    testTable.Upsert(interface, t);
+
+    table_test r;
+    r.set_keyid(20);
+    int ret = testTable.Select(interface, r);
+    LOG_DEBUG << "result: " << ret << ", " << r.ShortDebugString();
+
+    testTable.Delete(interface, r);
+}
+
+void TestCasePreparedStatement(MysqlInterface& interface) {
+    MysqlGenerator generator(database, table);
+    interface.SetPreparedStatement(true);
+    for(int i = 30; i != 40; ++i) {
+        table_test t;
+        t.set_keyid(i);
+        t.set_field1(i + 1);
+        t.set_field2(i + 2);
+        t.mutable_field3()->set_fieldstring("prepared 'quoted'");
+        interface.ExecuteSqlUpdateOnInsert(generator, t);
+    }
+    table_test r;
+    r.set_keyid(35);
+    int ret = interface.ExecuteSqlSelect(generator, r);
+    LOG_DEBUG << "result: " << ret << ", " << r.ShortDebugString();
+
+    table_test_repeated scan;
+    scan.add_fields()->set_field1(36);
+    ret = interface.ExecuteSqlSelect(generator, scan);
+    LOG_DEBUG << "result: " << ret << ", " << scan.ShortDebugString();
+
+    for(int i = 30; i != 40; ++i) {
+        table_test t;
+        t.set_keyid(i);
+        interface.ExecuteSqlDelete(generator, t);
+    }
+    interface.SetPreparedStatement(false);
+}
+
+void TestCasePreparedWhere(MysqlInterface& interface) {
+    // both generators share the table plan, each must run its own where condition
+    MysqlGenerator low(database, table, "where field2 < 45");
+    MysqlGenerator high(database, table, "where field2 >= 45");
+    interface.SetPreparedStatement(true);
+    for(int i = 40; i != 50; ++i) {
+        table_test t;
+        t.set_keyid(i);
+        t.set_field1(50);
+        t.set_field2(i);
+        interface.ExecuteSqlUpdateOnInsert(low, t);
+    }
+    table_test_repeated lowRows;
+    lowRows.add_fields()->set_field1(50);
+    int ret = interface.ExecuteSqlSelect(low, lowRows);
+    table_test_repeated highRows;
+    highRows.add_fields()->set_field1(50);
+    int ret2 = interface.ExecuteSqlSelect(high, highRows);
+    LOG_DEBUG << "result: " << ret << ", " << lowRows.fields_size() << ", " << ret2 << ", " << highRows.fields_size();
+
+    for(int i = 40; i != 50; ++i) {
+        table_test t;
+        t.set_keyid(i);
+        interface.ExecuteSqlDelete(low, t);
+    }
+    interface.SetPreparedStatement(false);
+}
+
+void TestCaseConnectionPool() {
+    MysqlPoolConfig config;
+    config.host = "127.0.0.1";
+    config.user = "root";
+    config.passwd = "seasondi";
+    config.size = 4;
+    MysqlConnectionPool pool(config);
+    LOG_DEBUG << "pool connected: " << pool.Start(config.size);
+
+    MysqlGenerator generator(database, table);
+    std::vector<std::thread> workers;
+    for(int i = 0; i != 16; ++i) {
+        workers.emplace_back([&pool, &generator, i]() {
+            table_test t;
+            t.set_keyid(100 + i);
+            t.set_field1(i);
+            pool.ExecuteSqlUpdateOnInsert(generator, t);
+
+            // a transaction stays on the connection of its handle
+            MysqlConnectionPool::Handle connection = pool.Acquire(-1);
+            if(!connection) return;
+            connection->SetAutoCommit(false);
+            connection->ExecuteSqlDelete(generator, t);
+            connection->Commit();
+        });
+    }
+    for(std::size_t i = 0; i != workers.size(); ++i) {
+        workers[i].join();
+    }
+    LOG_DEBUG << "pool idle: " << pool.IdleCount() << " of " << pool.Size();
+}
+
+void TestCaseReactor() {
+    MysqlPoolConfig config;
+    config.host = "127.0.0.1";
+    config.user = "root";
+    config.passwd = "seasondi";
+    config.size = 4;
+    MysqlReactor reactor;
+    LOG_DEBUG << "reactor connected: " << reactor.Start(config);
+    std::thread loop([&reactor]() { reactor.Run(); });
+
+    MysqlGenerator generator(database, table);
+    table_test_repeated rows;
+    for(int i = 0; i != 16; ++i) {
+        table_test* t = rows.add_fields();
+        t->set_keyid(200 + i);
+        t->set_field1(i);
+    }
+    reactor.ExecuteSqlUpdateOnInsert(generator, rows, [](const MysqlAsyncResult& result) {
+        LOG_DEBUG << "reactor upsert: " << result.error << ", affected rows: " << result.affectedRows;
+    });
+
+    // completes on the loop thread, result stays untouched until then
+    std::atomic<bool> done(false);
+    table_test_repeated selected;
+    selected.add_fields()->set_field1(1);
+    reactor.ExecuteSqlSelect(generator, selected, [&selected, &done](const MysqlAsyncResult& result) {
+        LOG_DEBUG << "reactor select: " << result.error << ", " << selected.ShortDebugString();
+        done = true;
+    });
+    while(!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    reactor.Stop();
+    loop.join();
+}
+
+void TestCaseWorker() {
+    MysqlPoolConfig config;
+    config.host = "127.0.0.1";
+    config.user = "root";
+    config.passwd = "seasondi";
+    config.autoCommit = false;
+    MysqlGenerator generator(database, table);
+    table_test t;
+    t.set_keyid(300);
+    t.set_field1(3);
+
+    // one connection in submit order, the insert and the delete commit together.
+    // generator and t outlive the worker, its destructor still runs what is queued
+    MysqlWorker worker(config);
+    MysqlAsyncExecutor& executor = worker;
+    executor.ExecuteSqlInsert(generator, t, [](const MysqlAsyncResult& result) {
+        LOG_DEBUG << "worker insert: " << result.error << ", affected rows: " << result.affectedRows;
+    });
+    executor.ExecuteSqlDelete(generator, t, [](const MysqlAsyncResult& result) {
+        LOG_DEBUG << "worker delete: " << result.error << ", affected rows: " << result.affectedRows;
+    });
+    executor.Commit([](const MysqlAsyncResult& result) {
+        LOG_DEBUG << "worker commit: " << result.error;
+    });
+}
+
+void TestCaseWriteBehind() {
+    MysqlPoolConfig config;
+    config.host = "127.0.0.1";
+    config.user = "root";
+    config.passwd = "seasondi";
+    config.size = 2;
+    MysqlConnectionPool pool(config);
+    MysqlGenerator generator(database, table);
+
+    MysqlWriteBehindConfig writeConfig;
+    writeConfig.upsert = true;
+    writeConfig.batchRows = 100;
+    writeConfig.maxRows = 1000;
+    writeConfig.pushTimeout = -1;
+    writeConfig.onError = [](int error, const google::protobuf::Message& rows) {
+        LOG_DEBUG << "write behind error: " << error << ", " << rows.ShortDebugString();
+    };
+    MysqlWriteBehind writer(pool, generator, table_test_repeated(), writeConfig);
+    std::vector<std::thread> producers;
+    for(int i = 0; i != 4; ++i) {
+        producers.emplace_back([&writer, i]() {
+            for(int j = 0; j != 250; ++j) {
+                table_test t;
+                t.set_keyid(1000 + i * 250 + j);
+                t.set_field1(j);
+                writer.Push(t);
+            }
+        });
+    }
+    for(std::size_t i = 0; i != producers.size(); ++i) {
+        producers[i].join();
+    }
+    LOG_DEBUG << "write behind flushed: " << writer.Flush(-1) << ", written: " << writer.Written() << ", dropped: " << writer.Dropped();
+}
+
+void TestCaseUpdateCoalescer() {
+    MysqlPoolConfig config;
+    config.host = "127.0.0.1";
+    config.user = "root";
+    config.passwd = "seasondi";
+    config.size = 2;
+    MysqlConnectionPool pool(config);
+    MysqlGenerator generator(database, table);
+
+    // rows keyed by field1 ('updatekey'), 1000 updates become one update per key
+    MysqlUpdateCoalescerConfig coalescerConfig;
+    coalescerConfig.flushInterval = 1000;
+    MysqlUpdateCoalescer coalescer(pool, generator, table_test_repeated(), coalescerConfig);
+    for(int i = 0; i != 1000; ++i) {
+        table_test t;
+        t.set_field1(i % 10);
+        if(i % 2) {
+            t.set_field2(i);
+        } else {
+            t.mutable_field3()->set_fielduint(i);
+        }
+        coalescer.Update(t);
+    }
+    LOG_DEBUG << "coalescer pending: " << coalescer.Pending() << ", updates: " << coalescer.Updates();
+    LOG_DEBUG << "coalescer flushed: " << coalescer.Flush(-1) << ", written: " << coalescer.Written() << ", dropped: " << coalescer.Dropped();
+}
+
 int main(int argc, char *argv[]) {
     START_ASYNC_LOG();
 
@@ -111,12 +392,25 @@ int main(int argc, char *argv[]) {
 
     TestCaseSelectRows(interface);
     TestCaseSelectMultiRows(interface);
+    TestCaseSelectArena(interface);
+    TestCaseSelectStream(interface);
 
     TestCaseUpdateOnInsert(interface);
 
     TestCaseDelete(interface);
     TestCaseDeleteMulti(interface);
+    TestCaseMultiStatements(interface);
+
+    TestCaseTable(interface);
+    TestCasePreparedStatement(interface);
+    TestCasePreparedWhere(interface);
 
     interface.Commit();
+
+    TestCaseConnectionPool();
+    TestCaseReactor();
+    TestCaseWorker();
+    TestCaseWriteBehind();
+    TestCaseUpdateCoalescer();
     return 0;
 }
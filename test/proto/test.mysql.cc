@@ -0,0 +1,177 @@
+// Generated by protoc-gen-mysql.  DO NOT EDIT!
+// source: test.proto
+
+#include "test.mysql.h"
+#include <soul/protobuf-mysql/MysqlSqlBuilder.h>
+
+namespace soul {
+
+bool table_field_messageMysqlCodec::HasColumn(const ::google::protobuf::Message& msg, int column) const {
+    const ::soul::table_field_message& m = static_cast<const ::soul::table_field_message&>(msg);
+    switch (column) {
+        case 0:
+            return m.has_filedint();
+        case 1:
+            return m.has_fielduint();
+        case 2:
+            return m.has_fieldstring();
+        default:
+            return false;
+    }
+}
+
+void table_field_messageMysqlCodec::AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const {
+    const ::soul::table_field_message& m = static_cast<const ::soul::table_field_message&>(msg);
+    switch (column) {
+        case 0:
+            builder.AppendInt32(m.filedint());
+            break;
+        case 1:
+            builder.AppendUInt32(m.fielduint());
+            break;
+        case 2:
+            builder.AppendQuoted(m.fieldstring().data(), m.fieldstring().length());
+            break;
+        default:
+            break;
+    }
+}
+
+void table_field_messageMysqlCodec::AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const {
+    const ::soul::table_field_message& m = static_cast<const ::soul::table_field_message&>(msg);
+    builder.Append('(');
+    builder.AppendInt32(m.filedint());
+    builder.Append(", ");
+    builder.AppendUInt32(m.fielduint());
+    builder.Append(", ");
+    builder.AppendQuoted(m.fieldstring().data(), m.fieldstring().length());
+    builder.Append(')');
+}
+
+bool table_field_messageMysqlCodec::SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const {
+    if(data == nullptr) return column >= 0 && column < 3;
+    ::soul::table_field_message& m = static_cast<::soul::table_field_message&>(msg);
+    switch (column) {
+        case 0:
+            {
+                int32_t value;
+                if(!ParseInt32(data, length, value)) return false;
+                m.set_filedint(value);
+            }
+            return true;
+        case 1:
+            {
+                uint32_t value;
+                if(!ParseUInt32(data, length, value)) return false;
+                m.set_fielduint(value);
+            }
+            return true;
+        case 2:
+            m.set_fieldstring(data, length);
+            return true;
+        default:
+            return false;
+    }
+}
+
+const table_field_messageMysqlCodec& table_field_messageMysqlCodec::Instance() {
+    static const table_field_messageMysqlCodec codec;
+    return codec;
+}
+
+bool table_testMysqlCodec::HasColumn(const ::google::protobuf::Message& msg, int column) const {
+    const ::soul::table_test& m = static_cast<const ::soul::table_test&>(msg);
+    switch (column) {
+        case 0:
+            return m.has_keyid();
+        case 1:
+            return m.has_field1();
+        case 2:
+            return m.has_field2();
+        case 3:
+            return m.has_field3();
+        default:
+            return false;
+    }
+}
+
+void table_testMysqlCodec::AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const {
+    const ::soul::table_test& m = static_cast<const ::soul::table_test&>(msg);
+    switch (column) {
+        case 0:
+            builder.AppendUInt32(m.keyid());
+            break;
+        case 1:
+            builder.AppendUInt32(m.field1());
+            break;
+        case 2:
+            builder.AppendUInt32(m.field2());
+            break;
+        case 3:
+            builder.AppendMessage(m.field3());
+            break;
+        default:
+            break;
+    }
+}
+
+void table_testMysqlCodec::AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const {
+    const ::soul::table_test& m = static_cast<const ::soul::table_test&>(msg);
+    builder.Append('(');
+    builder.AppendUInt32(m.keyid());
+    builder.Append(", ");
+    builder.AppendUInt32(m.field1());
+    builder.Append(", ");
+    builder.AppendUInt32(m.field2());
+    builder.Append(", ");
+    builder.AppendMessage(m.field3());
+    builder.Append(')');
+}
+
+bool table_testMysqlCodec::SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const {
+    if(data == nullptr) return column >= 0 && column < 4;
+    ::soul::table_test& m = static_cast<::soul::table_test&>(msg);
+    switch (column) {
+        case 0:
+            {
+                uint32_t value;
+                if(!ParseUInt32(data, length, value)) return false;
+                m.set_keyid(value);
+            }
+            return true;
+        case 1:
+            {
+                uint32_t value;
+                if(!ParseUInt32(data, length, value)) return false;
+                m.set_field1(value);
+            }
+            return true;
+        case 2:
+            {
+                uint32_t value;
+                if(!ParseUInt32(data, length, value)) return false;
+                m.set_field2(value);
+            }
+            return true;
+        case 3:
+            return m.mutable_field3()->ParseFromArray(data, static_cast<int>(length));
+        default:
+            return false;
+    }
+}
+
+const table_testMysqlCodec& table_testMysqlCodec::Instance() {
+    static const table_testMysqlCodec codec;
+    return codec;
+}
+
+namespace {
+    struct MysqlCodecRegistrar {
+        MysqlCodecRegistrar() {
+            ::soul::MysqlCodec::Register(::soul::table_field_message::descriptor(), &table_field_messageMysqlCodec::Instance());
+            ::soul::MysqlCodec::Register(::soul::table_test::descriptor(), &table_testMysqlCodec::Instance());
+        }
+    } registrar;
+}
+
+}  // namespace soul
@@ -0,0 +1,34 @@
+// Generated by protoc-gen-mysql.  DO NOT EDIT!
+// source: test.proto
+
+#ifndef PROTOBUF_MYSQL_test_INCLUDED
+#define PROTOBUF_MYSQL_test_INCLUDED
+
+#include "test.pb.h"
+#include <soul/protobuf-mysql/MysqlCodec.h>
+
+namespace soul {
+
+// columns: filedint, fielduint, fieldstring
+class table_field_messageMysqlCodec : public ::soul::MysqlCodec {
+    public:
+        virtual bool HasColumn(const ::google::protobuf::Message& msg, int column) const;
+        virtual void AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const;
+        virtual void AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const;
+        virtual bool SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const;
+        static const table_field_messageMysqlCodec& Instance();
+};
+
+// columns: keyid (primarykey), field1 (updatekey), field2, field3
+class table_testMysqlCodec : public ::soul::MysqlCodec {
+    public:
+        virtual bool HasColumn(const ::google::protobuf::Message& msg, int column) const;
+        virtual void AppendColumn(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg, int column) const;
+        virtual void AppendRow(::soul::MysqlSqlBuilder& builder, const ::google::protobuf::Message& msg) const;
+        virtual bool SetColumn(::google::protobuf::Message& msg, int column, const char* data, unsigned long length) const;
+        static const table_testMysqlCodec& Instance();
+};
+
+}  // namespace soul
+
+#endif  // PROTOBUF_MYSQL_test_INCLUDED